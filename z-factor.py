@@ -2,6 +2,15 @@ import numpy as np
 import matplotlib.pyplot as plt
 import time
 import math
+import os
+import collections
+import struct
+import zlib
+import ctypes
+import json
+import platform
+import sys
+import bisect
 
 '''
 	sg  - specific gravity (0.57 < sg < 1.68).
@@ -45,12 +54,11 @@ def calcTpr(T, sg):
 
 
 '''
-	Ppr    - pseudo reduced pressure, psia;
-	Tpr    - pseudo reduced temperature, K;
-	za, zb - z locate [za, zb] (bisection method).
-	return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS.
+	Ppr - pseudo reduced pressure, psia;
+	Tpr - pseudo reduced temperature, K.
+	return: C1..C5 - coefficients of the Dranchuk-Abbou Kassem residual.
 '''
-def calcZfactor_DAK(Ppr, Tpr, za = 0.7, zb = 1.1):
+def calcCoeffs_DAK(Ppr, Tpr):
 	invTpr  = 1.0 / Tpr
 	invTpr2 = invTpr*invTpr
 	invTpr3 = invTpr2*invTpr
@@ -65,13 +73,724 @@ def calcZfactor_DAK(Ppr, Tpr, za = 0.7, zb = 1.1):
 	C4  = 0.6134 * Rr_z2 * invTpr3
 	C5  = 0.7210 * Rr_z2
 
+	return(C1, C2, C3, C4, C5)
+
+
+'''
+	Tpr - pseudo reduced temperature, K (scalar or array).
+	return: D1..D5 - Tpr factors of the DAK coefficients, C1 = D1*Ppr,
+	C2 = D2*Ppr^2, C3 = D3*Ppr^5, C4 = D4*Ppr^2, C5 = D5*Ppr^2
+	(calcCoeffs_DAK with Rr_z = 0.27*Ppr/Tpr split off).
+'''
+def calcCoeffFactors_DAK(Tpr):
+	invTpr  = 1.0 / Tpr
+	invTpr2 = invTpr*invTpr
+	invTpr3 = invTpr2*invTpr
+	Rr      = 0.27 * invTpr
+	Rr2     = Rr*Rr
+
+	D1  = (0.3265 - 1.07 * invTpr - 0.5339 * invTpr3 +
+		  0.01569 * invTpr2*invTpr2 - 0.05165 * invTpr2*invTpr3) * Rr
+	tmp = -0.7361 * invTpr + 0.1844 * invTpr2
+	D2  = (0.5475 + tmp) * Rr2
+	D3  = 0.1056 * tmp * Rr2*Rr2*Rr
+	D4  = 0.6134 * Rr2 * invTpr3
+	D5  = 0.7210 * Rr2
+
+	return(D1, D2, D3, D4, D5)
+
+
+'''
+	z      - gas compressibility factor;
+	C1..C5 - coefficients of the DAK residual (calcCoeffs_DAK).
+	return: F(z) - residual of the Dranchuk-Abbou Kassem EoS.
+'''
+def calcResidual_DAK(z, C1, C2, C3, C4, C5):
+	invZ  = 1.0 / z
+	invZ2 = invZ*invZ
+	tmp   = C5 * invZ2
+	return(z - 1.0 - C1 * invZ - C2 * invZ2 + C3 * invZ2*invZ2*invZ -
+		  C4 * invZ2 * (1.0 + tmp) * math.exp(-tmp))
+
+
+'''
+	z      - gas compressibility factor (array);
+	C1..C5 - coefficients of the DAK residual (arrays broadcastable with z).
+	return: F(z) - calcResidual_DAK on arrays.
+'''
+def calcResidual_DAK_batch(z, C1, C2, C3, C4, C5):
+	invZ  = 1.0 / z
+	invZ2 = invZ*invZ
+	tmp   = C5 * invZ2
+	return(z - 1.0 - C1 * invZ - C2 * invZ2 + C3 * invZ2*invZ2*invZ -
+		  C4 * invZ2 * (1.0 + tmp) * np.exp(-tmp))
+
+'''
+	Ppr - pseudo reduced pressure, psia;
+	Tpr - pseudo reduced temperature, K.
+	return: z estimate, explicit rational fit of the DAK root
+	z = (1 + a Ppr + b Ppr^2) / (1 + c Ppr + d Ppr^2), a..d are cubics in
+	1/Tpr (z -> 1 as Ppr -> 0, z ~ Ppr at high pressure). Least squares over
+	0.2 <= Ppr <= 30, 1.05 <= Tpr <= 3: median relative error 0.1 %, 99 % of
+	the points within 14 %. Works on scalars and arrays.
+'''
+def estimateZ_DAK(Ppr, Tpr):
+	t = 1.0 / Tpr
+	a = ((2.05274 * t - 4.52232) * t + 2.93638) * t - 0.509211
+	b = ((-0.00843685 * t + 0.150749) * t - 0.0743268) * t + 0.0120777
+	c = ((1.33943 * t - 2.23511) * t + 1.78781) * t - 0.350467
+	d = ((-0.036929 * t + 0.0781448) * t - 0.0442235) * t + 0.00820655
+	return (1.0 + Ppr * (a + b * Ppr)) / (1.0 + Ppr * (c + d * Ppr))
+
+
+'''
+	Ppr - pseudo reduced pressure, psia;
+	Tpr - pseudo reduced temperature, K.
+	return: z - gas compressibility factor, explicit correlation of Papay
+	(1968), z = 1 - 3.52 Ppr / 10^(0.9813 Tpr) + 0.274 Ppr^2 / 10^(0.8157 Tpr).
+	Fits the Standing-Katz chart at low and moderate pressure only. Works on
+	scalars and arrays.
+'''
+def calcZfactor_Papay(Ppr, Tpr):
+	return(1.0 - 3.52 * Ppr / 10.0**(0.9813 * Tpr) +
+	       0.274 * Ppr*Ppr / 10.0**(0.8157 * Tpr))
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	C1..C5   - coefficients of the DAK residual (calcCoeffs_DAK);
+	margin   - relative half width of the first guess.
+	return: za, zb - bracket of the DAK root around estimateZ_DAK, the sign
+	change F(za) <= 0 <= F(zb) is checked and the side without it is widened
+	4 times until [0.05, 5] (physical z range at 0.2 <= Ppr <= 30,
+	1 <= Tpr <= 3); nIter - residual evaluations spent; fa, fb - F(za) and
+	F(zb) when they were evaluated here, None otherwise (solveZ_DAK_Brent
+	takes them instead of evaluating the ends again).
+	With margin = 0.01 the first guess holds at ~90 % of the points and the
+	solve starts from a ~3e-2 wide bracket instead of [2.5e-2, 16]: Brent
+	takes ~5 residual evaluations instead of 12, bisection 16 instead of 23.
+'''
+def calcBracket_DAK(Ppr, Tpr, C1, C2, C3, C4, C5, margin = 0.01):
+	zMin = 0.05
+	zMax = 5.0
+	z0   = min(max(estimateZ_DAK(Ppr, Tpr), zMin), zMax)
+	d    = margin * z0
+	za   = max(z0 - d, zMin)
+	zb   = min(z0 + d, zMax)
+	fa    = None
+	fb    = None
+	nIter = 0
+	lower = False
+
+	# F(za) > 0: the root is below, widen downwards (then F(zb) > 0 is known)
+	while (za > zMin):
+		nIter += 1
+		f = calcResidual_DAK(za, C1, C2, C3, C4, C5)
+		if (f <= 0.0):
+			fa = f
+			break
+		zb    = za
+		fb    = f
+		fa    = None
+		d    *= 4.0
+		za    = max(z0 - d, zMin)
+		lower = True
+
+	# F(zb) < 0: the root is above, widen upwards
+	while (zb < zMax and not lower):
+		nIter += 1
+		f = calcResidual_DAK(zb, C1, C2, C3, C4, C5)
+		if (f >= 0.0):
+			fb = f
+			break
+		za  = zb
+		fa  = f
+		fb  = None
+		d  *= 4.0
+		zb  = min(z0 + d, zMax)
+
+	return(za, zb, nIter, fa, fb)
+
+
+'''
+	z, nIter, status           - results of a solve;
+	full_output, return_status - the optional results asked for.
+	return: z, (z, nIter), (z, status) or (z, nIter, status).
+'''
+def packResults(z, nIter, status, full_output, return_status):
+	if (full_output and return_status):
+		return(z, nIter, status)
+	if (full_output):
+		return(z, nIter)
+	if (return_status):
+		return(z, status)
+	return z
+
+
+'''
+	Status flags of the solves (return_status), a point may have several:
+	ZSTATUS_CONVERGED      - none of the others;
+	ZSTATUS_MAX_ITER       - the solver hit the iteration limit;
+	ZSTATUS_OUT_OF_RANGE   - (Ppr, Tpr) outside the DAK validity range
+	                         0.2 <= Ppr <= 30, 1 <= Tpr <= 3;
+	ZSTATUS_NO_SIGN_CHANGE - the root ended on an end of the bracket, the
+	                         bracket has no sign change (or the root is within
+	                         the tolerance of its end).
+'''
+ZSTATUS_CONVERGED      = 0
+ZSTATUS_MAX_ITER       = 1
+ZSTATUS_OUT_OF_RANGE   = 2
+ZSTATUS_NO_SIGN_CHANGE = 4
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	z        - root;
+	failed   - the solver hit the iteration limit (nIter >= 100 besides the
+	           bracket evaluations, any converged solve here takes far less);
+	za, zb   - ends of the bracket without a checked sign (the bracket the
+	           solver started from, [0.05, 5] for calcBracket_DAK).
+	return: ZSTATUS_* flags of the solve.
+'''
+def calcStatus_DAK(Ppr, Tpr, z, failed, za, zb):
+	epsilon = 2.0e-6
+	status  = ZSTATUS_CONVERGED
+	if (failed):
+		status |= ZSTATUS_MAX_ITER
+	if (not (0.2 <= Ppr <= 30.0 and 1.0 <= Tpr <= 3.0)):
+		status |= ZSTATUS_OUT_OF_RANGE
+	if (z - za <= epsilon or zb - z <= epsilon):
+		status |= ZSTATUS_NO_SIGN_CHANGE
+	return status
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature (arrays);
+	z        - roots;
+	failed   - points whose solve hit the iteration limit (the bracket
+	           evaluations do not count, as nIter of calcStatus_DAK);
+	za, zb   - brackets, None for the automatic one (it only lacks a sign
+	           change when it is clamped at [0.05, 5]).
+	return: ZSTATUS_* flags per point (int8, calcStatus_DAK).
+'''
+def calcStatus_DAK_batch(Ppr, Tpr, z, failed, za = None, zb = None):
+	epsilon = 2.0e-6
+	if (za is None or zb is None):
+		za = 0.05
+		zb = 5.0
+	status = np.where(failed, ZSTATUS_MAX_ITER, ZSTATUS_CONVERGED)
+	status = status | np.where((Ppr < 0.2) | (Ppr > 30.0) | (Tpr < 1.0) |
+	                           (Tpr > 3.0) | np.isnan(Ppr) | np.isnan(Tpr),
+	                           ZSTATUS_OUT_OF_RANGE, 0)
+	status = status | np.where((z - za <= epsilon) | (zb - z <= epsilon),
+	                           ZSTATUS_NO_SIGN_CHANGE, 0)
+	return status.astype(np.int8)
+
+
+'''
+	x         - result of a bisection;
+	converged - the bisection stopped before the iteration limit;
+	xa, xb    - its starting bracket.
+	return: ZSTATUS_MAX_ITER if not converged, ZSTATUS_NO_SIGN_CHANGE if x
+	ended on an end of [xa, xb].
+'''
+def calcStatusBisection(x, converged, xa, xb):
+	epsilon = 2.0e-6
+	status  = ZSTATUS_CONVERGED
+	if (not converged):
+		status |= ZSTATUS_MAX_ITER
+	if (x - xa <= epsilon or xb - x <= epsilon):
+		status |= ZSTATUS_NO_SIGN_CHANGE
+	return status
+
+
+'''
+	status - ZSTATUS_* flags (array).
+	return: dict of the number of points with each flag ('converged' counts
+	the points without any flag) and the total.
+'''
+def countStatus(status):
+	status = np.asarray(status)
+	return {'points': int(status.size),
+	        'converged': int(np.count_nonzero(status == ZSTATUS_CONVERGED)),
+	        'maxIter': int(np.count_nonzero(status & ZSTATUS_MAX_ITER)),
+	        'outOfRange': int(np.count_nonzero(status & ZSTATUS_OUT_OF_RANGE)),
+	        'noSignChange': int(np.count_nonzero(status & ZSTATUS_NO_SIGN_CHANGE))}
+
+
+'''
+	Ppr         - pseudo reduced pressure, psia;
+	Tpr         - pseudo reduced temperature, K;
+	za, zb      - z locate [za, zb], calcBracket_DAK if not given;
+	method      - 'brent', 'bisection', 'newton' or 'halley'
+	              (all of them are safeguarded by [za, zb]);
+	full_output - return the number of residual evaluations too;
+	return_status - return the ZSTATUS_* flags of the solve too.
+	return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS,
+	(z, nIter) if full_output, nIter includes the bracket evaluations,
+	(z, status) if return_status, (z, nIter, status) if both.
+	'newton' runs in the native core when it is built (solveZ_DAK_Native).
+'''
+def calcZfactor_DAK(Ppr, Tpr, za = None, zb = None, method = 'brent',
+                    full_output = False, return_status = False):
+	if (method == 'newton' and zfactorCore is not None):
+		zn, nIter, status = solveZ_DAK_Native(Ppr, Tpr, za, zb)
+	else:
+		C1, C2, C3, C4, C5 = calcCoeffs_DAK(Ppr, Tpr)
+		zn, nIter, status = solveZ_DAK(Ppr, Tpr, C1, C2, C3, C4, C5, za, zb,
+		                               method)
+
+	return packResults(zn, nIter, status, full_output, return_status)
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	za, zb   - z locate [za, zb], the bracket of calcBracket_DAK if None.
+	return: z, nIter, status - solveZ_DAK with method = 'newton' in the
+	native core, one zfactor_dak_newton_point call with the scalars passed
+	by value (no arrays to marshal).
+'''
+def solveZ_DAK_Native(Ppr, Tpr, za, zb):
+	bracket = (za is None or zb is None)
+	nIter   = ctypes.c_int64()
+	atLimit = ctypes.c_int8()
+	fz      = ctypes.c_double() if (solverStats is not None) else None
+	zn = zfactorCore.zfactor_dak_newton_point(Ppr, Tpr,
+	                                          0.0 if (bracket) else za,
+	                                          0.0 if (bracket) else zb,
+	                                          int(bracket), nIter, atLimit, fz)
+
+	if (fz is not None):
+		solverStats.recordScalar('native', nIter.value, fz.value,
+		                         None if (bracket) else zb - za,
+		                         failed = atLimit.value != 0)
+	if (bracket):
+		za = 0.05
+		zb = 5.0
+	return(zn, nIter.value, calcStatus_DAK(Ppr, Tpr, zn, atLimit.value != 0,
+	                                       za, zb))
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	C1..C5   - coefficients of the DAK residual at (Ppr, Tpr);
+	za, zb   - z locate [za, zb], calcBracket_DAK if None;
+	method   - 'brent', 'bisection', 'newton' or 'halley'.
+	return: z, nIter, status - root of the DAK residual, residual evaluations
+	(bracket included) and ZSTATUS_* flags, the solver dispatch of
+	calcZfactor_DAK.
+'''
+def solveZ_DAK(Ppr, Tpr, C1, C2, C3, C4, C5, za, zb, method):
+	nBracket = 0
+	fa       = None
+	fb       = None
+	# the ends of the bracket not checked for the sign change
+	zLo = za
+	zHi = zb
+	if (za is None or zb is None):
+		za, zb, nBracket, fa, fb = calcBracket_DAK(Ppr, Tpr, C1, C2, C3, C4, C5)
+		zLo = 0.05
+		zHi = 5.0
+
+	if (method == 'brent'):
+		zn, nIter, fz = solveZ_DAK_Brent(C1, C2, C3, C4, C5, za, zb, fa, fb)
+	elif (method == 'newton' or method == 'halley'):
+		zn, nIter, fz = solveZ_DAK_Newton(C1, C2, C3, C4, C5, za, zb,
+		                                  method == 'halley')
+	elif (method == 'bisection'):
+		zn, nIter, fz = solveZ_DAK_Bisection(C1, C2, C3, C4, C5, za, zb)
+	else:
+		raise ValueError('calcZfactor_DAK(). Unknown method: ' + str(method))
+
+	if (solverStats is not None):
+		solverStats.recordScalar(method, nIter + nBracket, fz, zb - za, nBracket)
+	return(zn, nIter + nBracket,
+	       calcStatus_DAK(Ppr, Tpr, zn, nIter >= 100, zLo, zHi))
+
+
+'''
+	Bounded memoizing cache in front of calcZfactor_DAK.
+	size               - max number of cached points (>= 1);
+	quantPpr, quantTpr - quantization steps, a point is solved at the centre
+	                     of its (Ppr, Tpr) cell, so the cached z differs from
+	                     the exact one by about |dZ/dPpr|*quantPpr/2 +
+	                     |dZ/dTpr|*quantTpr/2 and does not depend on the call
+	                     order;
+	za, zb, method     - arguments of calcZfactor_DAK.
+	Eviction is CLOCK (second chance): every slot has a reference bit set on
+	a hit, the hand clears the bits until it finds a slot not used since its
+	last pass. hits, misses and evictions count the calls. A NaN or infinite
+	Ppr, Tpr has no cell: it is solved as is and not cached (a miss).
+'''
+class ZFactorCache:
+	def __init__(self, size = 65536, quantPpr = 1.0e-5, quantTpr = 1.0e-5,
+	             za = None, zb = None, method = 'brent'):
+		if (size < 1):
+			raise ValueError('ZFactorCache(). Size must be >= 1: ' + str(size))
+		self.size     = size
+		self.quantPpr = quantPpr
+		self.quantTpr = quantTpr
+		self.za       = za
+		self.zb       = zb
+		self.method   = method
+		self.clear()
+
+	def clear(self):
+		self.index     = {}
+		self.keys      = [None] * self.size
+		self.values    = [0.0] * self.size
+		self.used      = bytearray(self.size)
+		self.hand      = 0
+		self.count     = 0
+		self.hits      = 0
+		self.misses    = 0
+		self.evictions = 0
+
+	'''
+		Ppr - pseudo reduced pressure, psia;
+		Tpr - pseudo reduced temperature, K.
+		return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS.
+	'''
+	def calcZfactor(self, Ppr, Tpr):
+		try:
+			key = (round(Ppr / self.quantPpr), round(Tpr / self.quantTpr))
+		except (ValueError, OverflowError):
+			self.misses += 1
+			return calcZfactor_DAK(Ppr, Tpr, self.za, self.zb, self.method)
+		slot = self.index.get(key)
+		if (slot is not None):
+			self.hits      += 1
+			self.used[slot] = 1
+			return self.values[slot]
+
+		self.misses += 1
+		z = calcZfactor_DAK(key[0] * self.quantPpr, key[1] * self.quantTpr,
+		                    self.za, self.zb, self.method)
+
+		if (self.count < self.size):
+			slot        = self.count
+			self.count += 1
+		else:
+			while (self.used[self.hand]):
+				self.used[self.hand] = 0
+				self.hand = (self.hand + 1) % self.size
+			slot      = self.hand
+			self.hand = (self.hand + 1) % self.size
+			del self.index[self.keys[slot]]
+			self.evictions += 1
+
+		self.index[key]   = slot
+		self.keys[slot]   = key
+		self.values[slot] = z
+		self.used[slot]   = 0
+		return z
+
+	'''
+		return: dict of the counters and the hit rate.
+	'''
+	def stats(self):
+		calls = self.hits + self.misses
+		return {'hits': self.hits, 'misses': self.misses,
+		        'evictions': self.evictions, 'entries': self.count,
+		        'hitRate': self.hits / calls if (calls > 0) else 0.0}
+
+
+'''
+	DAK solves on one isotherm (isothermal reservoirs, lab PVT runs).
+	Tpr            - pseudo reduced temperature, K;
+	Ppr            - pseudo reduced pressure, psia, the coefficients of this
+	                 one are cached too (optional);
+	za, zb, method - arguments of calcZfactor_DAK (Tpr and Ppr are scalars).
+	invTpr, invTpr2, invTpr3 and the Tpr polynomials of C1..C5 are computed
+	once (calcCoeffFactors_DAK), a solve only multiplies them by the powers
+	of Ppr. calcZfactor_batch runs in the native core when it is built, the
+	factors stay in registers for the whole array there.
+'''
+class ZIsotherm:
+	def __init__(self, Tpr, Ppr = None, za = None, zb = None,
+	             method = 'brent'):
+		self.Tpr    = Tpr
+		self.za     = za
+		self.zb     = zb
+		self.method = method
+		self.D1, self.D2, self.D3, self.D4, self.D5 = calcCoeffFactors_DAK(Tpr)
+		self.Ppr    = Ppr
+		if (Ppr is not None):
+			if (np.ndim(Ppr) != 0):
+				raise ValueError('ZIsotherm(). Ppr is not a scalar, use ' +
+				                 'calcZfactor_batch for arrays')
+			self.coeffs = self.calcCoeffs(Ppr)
+
+	'''
+		Ppr - pseudo reduced pressure, psia (scalar or array).
+		return: C1..C5 - coefficients of the DAK residual at (Ppr, Tpr).
+	'''
+	def calcCoeffs(self, Ppr):
+		Ppr2 = Ppr*Ppr
+		return(self.D1 * Ppr, self.D2 * Ppr2, self.D3 * Ppr2*Ppr2*Ppr,
+		       self.D4 * Ppr2, self.D5 * Ppr2)
+
+	'''
+		Ppr           - pseudo reduced pressure, psia (the cached one if None);
+		full_output   - return the number of residual evaluations too;
+		return_status - return the ZSTATUS_* flags of the solve too.
+		return: z - gas compressibility factor based on Dranchuk-Abbou Kassem
+		EoS, (z, nIter) if full_output, status is appended if return_status.
+	'''
+	def calcZfactor(self, Ppr = None, full_output = False,
+	                return_status = False):
+		if (Ppr is not None):
+			coeffs = self.calcCoeffs(Ppr)
+		elif (self.Ppr is not None):
+			Ppr    = self.Ppr
+			coeffs = self.coeffs
+		else:
+			raise ValueError('ZIsotherm.calcZfactor(). No Ppr given and ' +
+			                 'none cached')
+
+		zn, nIter, status = solveZ_DAK(Ppr, self.Tpr, *coeffs, self.za, self.zb,
+		                               self.method)
+		return packResults(zn, nIter, status, full_output, return_status)
+
+	'''
+		Ppr           - pseudo reduced pressure, psia (array);
+		method        - 'newton', 'halley' or 'bisection', the one of the
+		                isotherm if None ('brent' has no batch solver);
+		full_output   - return the number of residual evaluations per point too;
+		return_status - return the ZSTATUS_* flags per point too.
+		return: z of the shape of Ppr, (z, nIter) if full_output, status is
+		appended if return_status (calcZfactor_DAK_grid with one row and the
+		cached D1..D5).
+	'''
+	def calcZfactor_batch(self, Ppr, method = None, full_output = False,
+	                      return_status = False):
+		if (method is None):
+			method = self.method
+		if (method != 'newton' and method != 'halley' and method != 'bisection'):
+			raise ValueError('ZIsotherm.calcZfactor_batch(). No batch solver ' +
+			                 'for method: ' + str(method))
+		Ppr = np.asarray(Ppr, dtype = float)
+		out = calcZfactor_DAK_grid(Ppr, self.Tpr, self.za, self.zb, method,
+		                           full_output = True, return_status = True,
+		                           factors = (self.D1, self.D2, self.D3,
+		                                      self.D4, self.D5))
+		z, nIter, status = [x.reshape(Ppr.shape) for x in out]
+		return packResults(z, nIter, status, full_output, return_status)
+
+
+'''
+	Counters of the DAK root solves, recorded while solverStats is set
+	(enableSolverStats):
+	calls, maxIterHits - solves and solves that hit the iteration limit
+	                     (maxIter residual evaluations besides the bracket);
+	iterHist           - iterHist[n] solves with n residual evaluations
+	                     (bracket included), the last bin is n >= maxIter;
+	residualHist       - |F| at exit (the last residual the solver evaluated:
+	                     F(z) for Brent, F of the previous iterate for Newton
+	                     and bisection), bin k is 10^(k-17) <= |F| < 10^(k-16)
+	                     (bin 0 also F = 0, the last bin |F| >= 1);
+	widthHist          - zb - za of the bracket the solver started from, bin k
+	                     is 10^(k-7) <= w < 10^(k-6) (bracket known only);
+	iterSum, residualSum, widthSum - sums of the observations of the
+	                     histograms (the non-finite ones left out);
+	methods            - solves per method ('native' for the native core).
+	The solvers hand over the residual they already have and the histograms
+	are lists, a scalar solve costs a few list increments and two bisections
+	of the bin edges, but the counters are off by default.
+'''
+class SolverStats:
+	# lower edges of residualHist bins 1..17 and widthHist bins 1..9
+	residualEdges = [float('1e' + str(k - 16)) for k in range(17)]
+	widthEdges    = [float('1e' + str(k - 6)) for k in range(9)]
+
+	def __init__(self, maxIter = 100):
+		self.maxIter = maxIter
+		self.clear()
+
+	def clear(self):
+		self.calls        = 0
+		self.maxIterHits  = 0
+		self.iterHist     = [0] * (self.maxIter + 1)
+		self.residualHist = [0] * 18
+		self.widthHist    = [0] * 10
+		self.iterSum      = 0
+		self.residualSum  = 0.0
+		self.widthSum     = 0.0
+		self.methods      = {}
+
+	'''
+		method   - solver name;
+		nIter    - residual evaluations (scalar or array);
+		residual - F(z) at exit (the same shape);
+		width    - zb - za of the starting bracket (the same shape, None if
+		           unknown);
+		nBracket - evaluations spent on the bracket (scalar or array);
+		failed   - solves that hit the iteration limit, from nIter - nBracket
+		           if None.
+	'''
+	def record(self, method, nIter, residual, width = None, nBracket = 0,
+	           failed = None):
+		nIter    = np.atleast_1d(np.asarray(nIter, dtype = np.int64))
+		residual = np.abs(np.atleast_1d(np.asarray(residual, dtype = float)))
+		n        = nIter.size
+
+		if (failed is None):
+			failed = np.count_nonzero(nIter - nBracket >= self.maxIter)
+		self.calls       += n
+		self.maxIterHits += int(failed)
+		addHistCounts(self.iterHist, np.minimum(nIter, self.maxIter))
+		self.iterSum     += int(nIter.sum())
+		self.residualSum += float(residual[np.isfinite(residual)].sum())
+		self.methods[method] = self.methods.get(method, 0) + n
+
+		with np.errstate(divide = 'ignore', invalid = 'ignore'):
+			k = np.floor(np.log10(residual)) + 17
+		k = np.where(residual > 0.0, np.clip(np.nan_to_num(k, nan = 17.0), 0, 17), 0)
+		addHistCounts(self.residualHist, k.astype(np.int64))
+
+		if (width is not None):
+			width = np.broadcast_to(np.asarray(width, dtype = float),
+			                        nIter.shape)
+			self.widthSum += float(width[np.isfinite(width)].sum())
+			with np.errstate(divide = 'ignore', invalid = 'ignore'):
+				k = np.floor(np.log10(width)) + 7
+			k = np.clip(np.nan_to_num(k, nan = 9.0, neginf = 0.0), 0, 9)
+			addHistCounts(self.widthHist, k.astype(np.int64).ravel())
+
+	'''
+		record() of one scalar solve (solveZ_DAK): plain integer increments,
+		the same bins (found by bisection of the edges) without the numpy
+		temporaries.
+	'''
+	def recordScalar(self, method, nIter, residual, width = None,
+	                 nBracket = 0, failed = None):
+		self.calls += 1
+		if (failed if (failed is not None) else
+		    nIter - nBracket >= self.maxIter):
+			self.maxIterHits += 1
+		self.iterHist[min(nIter, self.maxIter)] += 1
+		self.iterSum += nIter
+		self.methods[method] = self.methods.get(method, 0) + 1
+
+		residual = abs(residual)
+		if (residual < math.inf):
+			self.residualSum += residual
+		k = 0
+		if (residual > 0.0):
+			k = bisect.bisect_right(self.residualEdges, residual)
+		self.residualHist[k] += 1
+
+		if (width is not None):
+			if (abs(width) < math.inf):
+				self.widthSum += width
+			k = 9
+			if (width >= 0.0):
+				k = bisect.bisect_right(self.widthEdges, width)
+			self.widthHist[k] += 1
+
+	'''
+		return: dict of the counters (lists for the histograms).
+	'''
+	def stats(self):
+		calls = self.calls
+		return {'calls': calls, 'maxIterHits': self.maxIterHits,
+		        'meanIter': self.iterSum / calls if (calls > 0) else 0.0,
+		        'iterHist': list(self.iterHist),
+		        'residualHist': list(self.residualHist),
+		        'widthHist': list(self.widthHist),
+		        'methods': dict(self.methods)}
+
+	'''
+		path - output file, the stats() JSON.
+	'''
+	def dump(self, path):
+		with open(path, 'w') as f:
+			json.dump(self.stats(), f, indent = 1)
+
+	'''
+		prefix - metric name prefix.
+		return: the counters in the Prometheus text exposition format
+		(cumulative histograms with the upper bounds as 'le', _sum and
+		_count).
+	'''
+	def prometheus(self, prefix = 'zfactor_solver'):
+		lines = ['# TYPE ' + prefix + '_calls_total counter',
+		         prefix + '_calls_total ' + str(self.calls),
+		         '# TYPE ' + prefix + '_max_iter_total counter',
+		         prefix + '_max_iter_total ' + str(self.maxIterHits),
+		         '# TYPE ' + prefix + '_method_total counter']
+		for method, n in sorted(self.methods.items()):
+			lines.append(prefix + '_method_total{method="' + method + '"} ' +
+			             str(n))
+
+		hists = (('iterations', self.iterHist, self.iterSum,
+		          [str(n) for n in range(self.maxIter)]),
+		         ('residual', self.residualHist, self.residualSum,
+		          ['1e' + str(k - 16) for k in range(17)]),
+		         ('bracket_width', self.widthHist, self.widthSum,
+		          ['1e' + str(k - 6) for k in range(9)]))
+		for name, hist, observed, bounds in hists:
+			lines.append('# TYPE ' + prefix + '_' + name + ' histogram')
+			total = np.cumsum(hist)
+			for le, n in zip(bounds + ['+Inf'], total):
+				lines.append(prefix + '_' + name + '_bucket{le="' + le + '"} ' +
+				             str(int(n)))
+			lines.append(prefix + '_' + name + '_sum ' + str(observed))
+			lines.append(prefix + '_' + name + '_count ' + str(int(total[-1])))
+		return '\n'.join(lines) + '\n'
+
+
+solverStats = None
+
+
+'''
+	hist - histogram (list of counts);
+	bins - bin of every observation (integer array).
+	Adds the observations to hist.
+'''
+def addHistCounts(hist, bins):
+	counts = np.bincount(bins, minlength = len(hist))
+	for k in np.flatnonzero(counts):
+		hist[k] += int(counts[k])
+
+
+'''
+	nIter, residual - residual evaluations and the last residual per point
+	                  from the native core;
+	left            - points that hit the iteration limit.
+	Records a native solve in solverStats (the bracket is not known there).
+'''
+def recordNativeStats(nIter, residual, left):
+	solverStats.record('native', nIter.ravel(), residual.ravel(),
+	                   failed = left)
+
+
+'''
+	enable - start (a new SolverStats) or stop recording.
+	return: SolverStats being recorded or None.
+'''
+def enableSolverStats(enable = True):
+	global solverStats
+	solverStats = SolverStats() if (enable) else None
+	return solverStats
+
+
+'''
+	C1..C5 - coefficients of the DAK residual (calcCoeffs_DAK);
+	za, zb - z locate [za, zb] (bisection method).
+	return: z - root of the DAK residual, nIter - residual evaluations,
+	fz - the last residual evaluated (NaN if none was).
+'''
+def solveZ_DAK_Bisection(C1, C2, C3, C4, C5, za, zb):
 	i       = 0
+	nIter   = 0
 	maxIter = 100
 	inv2    = 0.5
 	epsilon = 2.0e-6
 	a       = za
 	b       = zb
 	zn      = 0.0
+	fz      = math.nan
 	one     = 1.0
 
 	# The method bisection
@@ -87,6 +806,7 @@ def calcZfactor_DAK(Ppr, Tpr, za = 0.7, zb = 1.1):
 		tmp = C5 * invZn2
 		fz = (zn - one - C1 * invZn - C2 * invZn2 + C3 * invZn2*invZn2*invZn -
 			 C4 * invZn2 * (one + tmp) * math.exp(-tmp))
+		nIter += 1
 
 		if (fz > 0):
 			b = zn
@@ -95,36 +815,749 @@ def calcZfactor_DAK(Ppr, Tpr, za = 0.7, zb = 1.1):
 		elif (fz == 0.0):
 			break
 
-	if (i == maxIter - 1):
-		print('calcZfactor_DAK(). Warning: max iter!\n')
+	return(zn, nIter, fz)
+
+
+'''
+	C1..C5 - coefficients of the DAK residual (calcCoeffs_DAK);
+	za, zb - z locate [za, zb], F(za) < 0 < F(zb);
+	halley - use Halley's correction of the Newton step.
+	return: z - root of the DAK residual, nIter - residual evaluations,
+	fz - the residual at the last iterate before z.
+'''
+def solveZ_DAK_Newton(C1, C2, C3, C4, C5, za, zb, halley = False):
+	i       = 0
+	maxIter = 100
+	inv2    = 0.5
+	epsilon = 2.0e-6
+	a       = za
+	b       = zb
+	zn      = (a + b) * inv2
+	one     = 1.0
+
+	# Newton (Halley) steps, a step leaving [a, b] is replaced by bisection
+	for i in range(maxIter):
 
-	return zn
+		invZn  = one / zn
+		invZn2 = invZn*invZn
+		invZn3 = invZn2*invZn
+		tmp    = C5 * invZn2
+		ex     = math.exp(-tmp)
+		fz = (zn - one - C1 * invZn - C2 * invZn2 + C3 * invZn2*invZn3 -
+			 C4 * invZn2 * (one + tmp) * ex)
+
+		if (fz > 0):
+			b = zn
+		elif (fz < 0):
+			a = zn
+		elif (fz == 0.0):
+			break
+
+		# dF/dz
+		dfz = (one + C1 * invZn2 + 2.0 * C2 * invZn3 - 5.0 * C3 * invZn3*invZn3 +
+			  2.0 * C4 * invZn3 * (one + tmp - tmp*tmp) * ex)
+
+		zNew = zn
+		if (dfz != 0.0):
+			step = fz / dfz
+			if (halley):
+				# d2F/dz2
+				d2fz = (-2.0 * C1 * invZn3 - 6.0 * C2 * invZn2*invZn2 +
+					   30.0 * C3 * invZn3*invZn2*invZn2 - 2.0 * C4 * invZn2*invZn2 *
+					   (3.0 + 3.0 * tmp - 9.0 * tmp*tmp + 2.0 * tmp*tmp*tmp) * ex)
+				denom = one - inv2 * step * d2fz / dfz
+				if (denom > inv2):
+					step = step / denom
+			zNew = zn - step
+
+		if (not (a < zNew < b)):
+			zNew = (a + b) * inv2
+
+		convergence = min(abs(zNew - zn), abs(b - a))
+		zn = zNew
+		if(convergence <= epsilon):
+			break
+
+	return(zn, i + 1, fz)
 
 
 '''
-	Ppr    - pseudo reduced pressure, psia;
-	Tpr    - pseudo reduced temperature, K;
-	da, db - dZdT locate [da, db] (bisection method).
-	za, zb - z locate [za, zb] (bisection method).
-	return: dZ/dTpr,
-	Z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS.
+	C1..C5 - coefficients of the DAK residual (calcCoeffs_DAK);
+	za, zb - z locate [za, zb];
+	fa, fb - F(za) and F(zb) if known (calcBracket_DAK), evaluated if None.
+	return: z - root of the DAK residual, nIter - residual evaluations,
+	fz - F(z).
+	Brent's method: inverse quadratic interpolation and secant steps that are
+	rejected in favour of bisection whenever they do not shrink the bracket
+	fast enough. Without a sign change on [za, zb] falls back to bisection.
 '''
-def calc_dZdTpr(Ppr, Tpr, da, db, za = 0.7, zb = 1.1):
-	z       = calcZfactor_DAK(Ppr, Tpr, za, zb)
-	dRrdT   = 0.27*Ppr / (Tpr*Tpr * z)
+def solveZ_DAK_Brent(C1, C2, C3, C4, C5, za, zb, fa = None, fb = None):
 	i       = 0
 	maxIter = 100
 	inv2    = 0.5
 	epsilon = 2.0e-6
-	a       = da
-	b       = db
-	dZdTn   = 0.0
+	eps     = 2.220446049250313e-16
+	a       = za
+	b       = zb
+	nIter   = 0
+	if (fa is None):
+		fa     = calcResidual_DAK(a, C1, C2, C3, C4, C5)
+		nIter += 1
+	if (fb is None):
+		fb     = calcResidual_DAK(b, C1, C2, C3, C4, C5)
+		nIter += 1
+
+	if ((fa > 0.0 and fb > 0.0) or (fa < 0.0 and fb < 0.0)):
+		zn, n, fz = solveZ_DAK_Bisection(C1, C2, C3, C4, C5, za, zb)
+		return(zn, nIter + n, fz)
+
+	c  = b
+	fc = fb
+	d  = b - a
+	e  = d
+
+	for i in range(maxIter):
+
+		if ((fb > 0.0 and fc > 0.0) or (fb < 0.0 and fc < 0.0)):
+			c  = a
+			fc = fa
+			d  = b - a
+			e  = d
+		if (abs(fc) < abs(fb)):
+			a  = b
+			b  = c
+			c  = a
+			fa = fb
+			fb = fc
+			fc = fa
+
+		tol = 2.0 * eps * abs(b) + inv2 * epsilon
+		xm  = inv2 * (c - b)
+		if (abs(xm) <= tol or fb == 0.0):
+			break
+
+		if (abs(e) >= tol and abs(fa) > abs(fb)):
+			s = fb / fa
+			if (a == c):
+				# Secant step
+				p = 2.0 * xm * s
+				q = 1.0 - s
+			else:
+				# Inverse quadratic interpolation
+				q = fa / fc
+				r = fb / fc
+				p = s * (2.0 * xm * q * (q - r) - (b - a) * (r - 1.0))
+				q = (q - 1.0) * (r - 1.0) * (s - 1.0)
+			if (p > 0.0):
+				q = -q
+			p = abs(p)
+			if (2.0 * p < min(3.0 * xm * q - abs(tol * q), abs(e * q))):
+				e = d
+				d = p / q
+			else:
+				d = xm
+				e = d
+		else:
+			d = xm
+			e = d
+
+		a  = b
+		fa = fb
+		if (abs(d) > tol):
+			b += d
+		else:
+			b += math.copysign(tol, xm)
+		fb = calcResidual_DAK(b, C1, C2, C3, C4, C5)
+		nIter += 1
+
+	return(b, nIter, fb)
+
+
+'''
+	return: native compute core (zfactor_core.cpp built into libzfactor.so
+	next to this script) or None, then the numpy path is used.
+	The core picks the widest instruction set at load time, zfactor_isa()
+	reports it, ZFACTOR_ISA=scalar|avx2|avx512 overrides it.
+'''
+def loadZfactorCore():
+	path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+	                    'libzfactor.so')
+	if (not os.path.exists(path)):
+		return None
+
+	try:
+		lib = ctypes.CDLL(path)
+	except OSError:
+		return None
+
+	vec  = np.ctypeslib.ndpointer(dtype = np.float64, flags = 'C_CONTIGUOUS')
+	ivec = np.ctypeslib.ndpointer(dtype = np.int64, flags = 'C_CONTIGUOUS')
+	bvec = np.ctypeslib.ndpointer(dtype = np.int8, flags = 'C_CONTIGUOUS')
+
+	# vec or None for NULL (the optional outputs)
+	class ovec(vec):
+		@classmethod
+		def from_param(cls, obj):
+			if (obj is None):
+				return None
+			return vec.from_param(obj)
+
+	lib.zfactor_dak_newton.restype  = ctypes.c_int64
+	lib.zfactor_dak_newton.argtypes = [ctypes.c_int64, vec, vec, vec, vec,
+	                                   vec, ivec, bvec, ovec]
+	lib.zfactor_dak_newton_auto.restype  = ctypes.c_int64
+	lib.zfactor_dak_newton_auto.argtypes = [ctypes.c_int64, vec, vec, vec, ivec,
+	                                        bvec, ovec]
+	lib.zfactor_dak_sweep.restype  = ctypes.c_int64
+	lib.zfactor_dak_sweep.argtypes = [ctypes.c_int64, ctypes.c_int64, vec, vec,
+	                                  ctypes.c_int, vec, ivec, bvec, ovec]
+	lib.zfactor_dak_grid.restype  = ctypes.c_int64
+	lib.zfactor_dak_grid.argtypes = [ctypes.c_int64, ctypes.c_int64, vec, vec,
+	                                 vec, ctypes.c_double, ctypes.c_double,
+	                                 ctypes.c_int, vec, ivec, bvec, ovec]
+	lib.zfactor_dak_newton_parallel.restype  = ctypes.c_int64
+	lib.zfactor_dak_newton_parallel.argtypes = [ctypes.c_int64, vec, vec, vec,
+	                                            vec, vec, ivec, bvec, ovec,
+	                                            ctypes.c_int64]
+	lib.zfactor_dak_newton_auto_parallel.restype  = ctypes.c_int64
+	lib.zfactor_dak_newton_auto_parallel.argtypes = [ctypes.c_int64, vec, vec,
+	                                                 vec, ivec, bvec, ovec,
+	                                                 ctypes.c_int64]
+	lib.zfactor_dak_newton_point.restype  = ctypes.c_double
+	lib.zfactor_dak_newton_point.argtypes = [ctypes.c_double, ctypes.c_double,
+	                                         ctypes.c_double, ctypes.c_double,
+	                                         ctypes.c_int,
+	                                         ctypes.POINTER(ctypes.c_int64),
+	                                         ctypes.POINTER(ctypes.c_int8),
+	                                         ctypes.POINTER(ctypes.c_double)]
+	lib.zfactor_pool_init.restype  = ctypes.c_int
+	lib.zfactor_pool_init.argtypes = [ctypes.c_int]
+	lib.zfactor_pool_size.restype  = ctypes.c_int
+	lib.zfactor_pool_size.argtypes = []
+	lib.zfactor_isa.restype  = ctypes.c_char_p
+	lib.zfactor_isa.argtypes = []
+	lib.zfactor_table_eval.restype  = None
+	lib.zfactor_table_eval.argtypes = [ctypes.c_int64, vec, vec,
+	                                   ctypes.c_double, ctypes.c_double,
+	                                   ctypes.c_int64, ctypes.c_double,
+	                                   ctypes.c_double, ctypes.c_int64, vec, vec]
+	ivec32 = np.ctypeslib.ndpointer(dtype = np.int32, flags = 'C_CONTIGUOUS')
+	lib.zfactor_quadtree_eval.restype  = None
+	lib.zfactor_quadtree_eval.argtypes = [ctypes.c_int64, vec, vec,
+	                                      ctypes.c_double, ctypes.c_double,
+	                                      ctypes.c_int64, ctypes.c_double,
+	                                      ctypes.c_double, ctypes.c_int64,
+	                                      ivec32, vec, vec]
+	lib.zfactor_poly_eval.restype  = None
+	lib.zfactor_poly_eval.argtypes = [ctypes.c_int64, vec, vec,
+	                                  ctypes.c_double, ctypes.c_double,
+	                                  ctypes.c_int64, ctypes.c_double,
+	                                  ctypes.c_double, ctypes.c_int64,
+	                                  ctypes.c_int, ctypes.c_int, vec, vec]
+	lib.zfactor_ct_eval.restype    = None
+	lib.zfactor_ct_eval.argtypes   = [ctypes.c_int64, vec, vec, vec]
+	lib.zfactor_ct_domain.restype  = None
+	lib.zfactor_ct_domain.argtypes = [vec]
+	return lib
+
+
+zfactorCore = loadZfactorCore()
+
+
+'''
+	threads - threads of the native pool, 0 for one per core.
+	return: size of the pool (1 without the native core). The pool is kept
+	between the calcZfactor_DAK_batch(threads != 1) calls, a timestep loop
+	does not start threads; calling this restarts it.
+'''
+def setZfactorThreads(threads = 0):
+	if (zfactorCore is None):
+		return 1
+	return zfactorCore.zfactor_pool_init(threads)
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature (1d arrays);
+	C1..C5   - coefficients of the DAK residual (calcCoeffs_DAK);
+	margin   - relative half width of the first guess (scalar or array);
+	z0       - centre of the first guess, estimateZ_DAK if not given.
+	return: za, zb, nIter - calcBracket_DAK for every point, the points that
+	have to be widened are iterated together.
+'''
+def calcBracket_DAK_batch(Ppr, Tpr, C1, C2, C3, C4, C5, margin = 0.01,
+                          z0 = None):
+	zMin  = 0.05
+	zMax  = 5.0
+	if (z0 is None):
+		z0 = estimateZ_DAK(Ppr, Tpr)
+	z0    = np.clip(z0, zMin, zMax)
+	d     = margin * z0
+	za    = np.maximum(z0 - d, zMin)
+	zb    = np.minimum(z0 + d, zMax)
+	nIter = np.full(z0.size, 2, dtype = np.int64)
+
+	fa = calcResidual_DAK_batch(za, C1, C2, C3, C4, C5)
+	fb = calcResidual_DAK_batch(zb, C1, C2, C3, C4, C5)
+
+	# F(za) > 0: the root is below, widen downwards
+	idx = np.flatnonzero((fa > 0.0) & (za > zMin))
+	while (idx.size > 0):
+		zb[idx]  = za[idx]
+		d[idx]  *= 4.0
+		za[idx]  = np.maximum(z0[idx] - d[idx], zMin)
+		idx = idx[za[idx] > zMin]
+		nIter[idx] += 1
+		fi  = calcResidual_DAK_batch(za[idx], C1[idx], C2[idx], C3[idx],
+		                             C4[idx], C5[idx])
+		idx = idx[fi > 0.0]
+
+	# F(zb) < 0: the root is above, widen upwards
+	idx = np.flatnonzero((fb < 0.0) & (fa <= 0.0) & (zb < zMax))
+	while (idx.size > 0):
+		za[idx]  = zb[idx]
+		d[idx]  *= 4.0
+		zb[idx]  = np.minimum(z0[idx] + d[idx], zMax)
+		idx = idx[zb[idx] < zMax]
+		nIter[idx] += 1
+		fi  = calcResidual_DAK_batch(zb[idx], C1[idx], C2[idx], C3[idx],
+		                             C4[idx], C5[idx])
+		idx = idx[fi < 0.0]
+
+	return(za, zb, nIter)
+
+
+'''
+	Ppr         - pseudo reduced pressure, psia (array);
+	Tpr         - pseudo reduced temperature, K (array, broadcastable with Ppr);
+	za, zb      - z locate [za, zb] (scalars or broadcastable arrays),
+	              calcBracket_DAK_batch if not given;
+	method      - 'newton', 'halley' or 'bisection' (safeguarded by [za, zb]);
+	full_output - return the number of residual evaluations per point too;
+	return_status - return the ZSTATUS_* flags per point too (countStatus
+	              aggregates them);
+	threads     - 1: the calling thread, 0: the native thread pool (one
+	              thread per core unless setZfactorThreads sized it), k: the
+	              pool restarted with k threads if it has another size;
+	chunk       - points per chunk of the pool.
+	return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS
+	of the broadcast shape, (z, nIter) if full_output, nIter includes the
+	bracket evaluations, status is appended if return_status.
+	All points are iterated together, a point leaves the working set as soon
+	as it has converged, NaN Ppr or Tpr give z = NaN. 'newton' runs in the
+	native core when it is built, the other methods and the numpy path ignore
+	threads.
+'''
+def calcZfactor_DAK_batch(Ppr, Tpr, za = None, zb = None, method = 'newton',
+                          full_output = False, return_status = False,
+                          threads = 1, chunk = 4096):
+	if (method != 'newton' and method != 'halley' and method != 'bisection'):
+		raise ValueError('calcZfactor_DAK_batch(). Unknown method: ' +
+		                 str(method))
+
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+	bracket  = (za is None or zb is None)
+	if (not bracket):
+		Ppr, Tpr, za, zb = np.broadcast_arrays(Ppr, Tpr,
+		                                       np.asarray(za, dtype = float),
+		                                       np.asarray(zb, dtype = float))
+	shape = Ppr.shape
+	Ppr   = np.ascontiguousarray(Ppr.ravel())
+	Tpr   = np.ascontiguousarray(Tpr.ravel())
+
+	if (method == 'newton' and zfactorCore is not None):
+		n      = Ppr.size
+		zn     = np.empty(n)
+		nIter  = np.empty(n, dtype = np.int64)
+		failed = np.empty(n, dtype = np.int8)
+		fExit  = np.empty(n) if (solverStats is not None) else None
+		if (threads != 1):
+			if (threads != 0 and threads != zfactorCore.zfactor_pool_size()):
+				zfactorCore.zfactor_pool_init(threads)
+			if (bracket):
+				left = zfactorCore.zfactor_dak_newton_auto_parallel(
+					n, Ppr, Tpr, zn, nIter, failed, fExit, chunk)
+			else:
+				left = zfactorCore.zfactor_dak_newton_parallel(
+					n, Ppr, Tpr, np.ascontiguousarray(za.ravel()),
+					np.ascontiguousarray(zb.ravel()), zn, nIter, failed, fExit,
+					chunk)
+		elif (bracket):
+			left = zfactorCore.zfactor_dak_newton_auto(n, Ppr, Tpr, zn, nIter,
+			                                           failed, fExit)
+		else:
+			left = zfactorCore.zfactor_dak_newton(
+				n, Ppr, Tpr, np.ascontiguousarray(za.ravel()),
+				np.ascontiguousarray(zb.ravel()), zn, nIter, failed, fExit)
+		if (fExit is not None):
+			recordNativeStats(nIter, fExit, left)
+	else:
+		C1, C2, C3, C4, C5 = calcCoeffs_DAK(Ppr, Tpr)
+		nBracket = 0
+		if (bracket):
+			za, zb, nBracket = calcBracket_DAK_batch(Ppr, Tpr,
+			                                         C1, C2, C3, C4, C5)
+		zn, nIter = solveZ_DAK_batch(C1, C2, C3, C4, C5, np.ravel(za),
+		                             np.ravel(zb), method, nBracket)
+		failed    = nIter >= 100
+		nIter    += nBracket
+
+	status = None
+	if (return_status):
+		if (bracket):
+			status = calcStatus_DAK_batch(Ppr, Tpr, zn, failed)
+		else:
+			status = calcStatus_DAK_batch(Ppr, Tpr, zn, failed, za.ravel(),
+			                              zb.ravel())
+		status = status.reshape(shape)
+	return packResults(zn.reshape(shape), nIter.reshape(shape), status,
+	                   full_output, return_status)
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature (broadcastable arrays);
+	nIter    - number of Newton steps.
+	return: z - gas compressibility factor after nIter Newton steps from
+	estimateZ_DAK, clamped to [0.05, 5], without convergence test or bracket
+	(nIter residual and dF/dz evaluations per point). A cheap fixed cost
+	estimate: nIter = 0 is the explicit fit, every step roughly squares its
+	relative error away from the near critical Tpr ~ 1.
+'''
+def calcZfactor_DAK_iter(Ppr, Tpr, nIter = 2):
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+	C1, C2, C3, C4, C5 = calcCoeffs_DAK(Ppr, Tpr)
+	one = 1.0
+	z   = estimateZ_DAK(Ppr, Tpr)
+
+	for i in range(nIter):
+		invZn  = one / z
+		invZn2 = invZn*invZn
+		invZn3 = invZn2*invZn
+		tmp    = C5 * invZn2
+		ex     = np.exp(-tmp)
+		fz  = (z - one - C1 * invZn - C2 * invZn2 + C3 * invZn2*invZn3 -
+		       C4 * invZn2 * (one + tmp) * ex)
+		dfz = (one + C1 * invZn2 + 2.0 * C2 * invZn3 - 5.0 * C3 * invZn3*invZn3 +
+		       2.0 * C4 * invZn3 * (one + tmp - tmp*tmp) * ex)
+		z   = np.clip(z - fz / dfz, 0.05, 5.0)
+	return z
+
+
+'''
+	Ppr         - pseudo reduced pressure, psia (vector of the columns);
+	Tpr         - pseudo reduced temperature, K (vector of the rows);
+	za, zb      - z locate [za, zb] (scalars), calcBracket_DAK_batch if not
+	              given;
+	method      - 'newton', 'halley' or 'bisection';
+	full_output - return the number of residual evaluations per point too;
+	return_status - return the ZSTATUS_* flags per point too;
+	factors     - D1..D5 of Tpr (calcCoeffFactors_DAK), computed if None.
+	return: z[i, j] at (Ppr[j], Tpr[i]) - gas compressibility factor based on
+	Dranchuk-Abbou Kassem EoS on the cartesian grid, (z, nIter) if full_output,
+	status is appended if return_status.
+	The Tpr factors of C1..C5 are computed once per row and Ppr, Ppr^2, Ppr^5
+	once per column, a coefficient is one product.
+	The grid is solved in blocks of rows of about gridBlock points so the
+	working arrays stay in cache. 'newton' runs in the native core when it is
+	built (blocks of 512 columns there).
+'''
+def calcZfactor_DAK_grid(Ppr, Tpr, za = None, zb = None, method = 'newton',
+                         full_output = False, gridBlock = 65536,
+                         return_status = False, factors = None):
+	if (method != 'newton' and method != 'halley' and method != 'bisection'):
+		raise ValueError('calcZfactor_DAK_grid(). Unknown method: ' +
+		                 str(method))
+
+	Ppr     = np.ascontiguousarray(np.ravel(Ppr), dtype = float)
+	Tpr     = np.ascontiguousarray(np.ravel(Tpr), dtype = float)
+	nP      = Ppr.size
+	nT      = Tpr.size
+	bracket = (za is None or zb is None)
+	z       = np.empty((nT, nP))
+	nIter   = np.empty((nT, nP), dtype = np.int64)
+	failed  = np.empty((nT, nP), dtype = np.int8)
+	if (factors is None):
+		factors = calcCoeffFactors_DAK(Tpr)
+	D1, D2, D3, D4, D5 = [np.broadcast_to(np.asarray(d, dtype = float).ravel(),
+	                                      (nT,)) for d in factors]
+
+	if (method == 'newton' and zfactorCore is not None):
+		D     = np.ascontiguousarray(np.stack((D1, D2, D3, D4, D5)))
+		fExit = np.empty((nT, nP)) if (solverStats is not None) else None
+		left  = zfactorCore.zfactor_dak_grid(nP, nT, Ppr, Tpr, D,
+		                                     0.0 if (bracket) else za,
+		                                     0.0 if (bracket) else zb,
+		                                     int(bracket), z, nIter, failed,
+		                                     fExit)
+		if (fExit is not None):
+			recordNativeStats(nIter, fExit, left)
+	else:
+		P2   = Ppr*Ppr
+		P5   = P2*P2*Ppr
+		rows = max(1, gridBlock // max(nP, 1))
+
+		for i0 in range(0, nT, rows):
+			i1 = min(i0 + rows, nT)
+			C1 = np.outer(D1[i0:i1], Ppr).ravel()
+			C2 = np.outer(D2[i0:i1], P2).ravel()
+			C3 = np.outer(D3[i0:i1], P5).ravel()
+			C4 = np.outer(D4[i0:i1], P2).ravel()
+			C5 = np.outer(D5[i0:i1], P2).ravel()
+
+			a        = za
+			b        = zb
+			nBracket = 0
+			if (bracket):
+				a, b, nBracket = calcBracket_DAK_batch(
+					np.tile(Ppr, i1 - i0), np.repeat(Tpr[i0:i1], nP),
+					C1, C2, C3, C4, C5)
+			zi, ni = solveZ_DAK_batch(C1, C2, C3, C4, C5, a, b, method, nBracket)
+			z[i0:i1]      = zi.reshape(i1 - i0, nP)
+			nIter[i0:i1]  = (ni + nBracket).reshape(i1 - i0, nP)
+			failed[i0:i1] = (ni >= 100).reshape(i1 - i0, nP)
+
+	status = None
+	if (return_status):
+		status = calcStatus_DAK_batch(Ppr[np.newaxis, :], Tpr[:, np.newaxis], z,
+		                              failed, za, zb)
+	return packResults(z, nIter, status, full_output, return_status)
+
+
+'''
+	C1..C5 - coefficients of the DAK residual (1d arrays);
+	za, zb   - z locate [za, zb] (scalars or arrays of the same size);
+	method   - 'newton', 'halley' or 'bisection';
+	nBracket - residual evaluations spent on [za, zb] (solverStats only).
+	return: z, nIter - roots of the DAK residual and residual evaluations per
+	point, the numpy loop of calcZfactor_DAK_batch.
+'''
+def solveZ_DAK_batch(C1, C2, C3, C4, C5, za, zb, method = 'newton',
+                     nBracket = 0):
+	maxIter = 100
+	inv2    = 0.5
+	epsilon = 2.0e-6
+	one     = 1.0
+	halley  = (method == 'halley')
+	a, b    = np.broadcast_arrays(np.asarray(za, dtype = float),
+	                              np.asarray(zb, dtype = float), C1)[:2]
+	a       = a.copy()
+	b       = b.copy()
+	zn      = (a + b) * inv2
+	nIter   = np.zeros(zn.size, dtype = np.int64)
+	idx     = np.arange(zn.size)
+	# the last residual per point, kept for solverStats only
+	fExit   = np.full(zn.size, np.nan) if (solverStats is not None) else None
+
+	for i in range(maxIter):
+		if (idx.size == 0):
+			break
+
+		z  = zn[idx]
+		ai = a[idx]
+		bi = b[idx]
+		c1 = C1[idx]
+		c2 = C2[idx]
+		c3 = C3[idx]
+		c4 = C4[idx]
+		c5 = C5[idx]
+
+		invZn  = one / z
+		invZn2 = invZn*invZn
+		invZn3 = invZn2*invZn
+		tmp    = c5 * invZn2
+		ex     = np.exp(-tmp)
+		fz = (z - one - c1 * invZn - c2 * invZn2 + c3 * invZn2*invZn3 -
+			 c4 * invZn2 * (one + tmp) * ex)
+		nIter[idx] += 1
+		if (fExit is not None):
+			fExit[idx] = fz
+
+		ai = np.where(fz < 0.0, z, ai)
+		bi = np.where(fz > 0.0, z, bi)
+		a[idx] = ai
+		b[idx] = bi
+
+		if (method == 'bisection'):
+			zNew = (ai + bi) * inv2
+			convergence = np.abs(bi - ai)
+		else:
+			# dF/dz
+			dfz = (one + c1 * invZn2 + 2.0 * c2 * invZn3 - 5.0 * c3 * invZn3*invZn3 +
+				  2.0 * c4 * invZn3 * (one + tmp - tmp*tmp) * ex)
+			dfz  = np.where(dfz == 0.0, np.inf, dfz)
+			step = fz / dfz
+			if (halley):
+				# d2F/dz2
+				d2fz = (-2.0 * c1 * invZn3 - 6.0 * c2 * invZn2*invZn2 +
+					   30.0 * c3 * invZn3*invZn2*invZn2 - 2.0 * c4 * invZn2*invZn2 *
+					   (3.0 + 3.0 * tmp - 9.0 * tmp*tmp + 2.0 * tmp*tmp*tmp) * ex)
+				denom = one - inv2 * step * d2fz / dfz
+				step  = np.where(denom > inv2, step / denom, step)
+			zNew = z - step
+			zNew = np.where((ai < zNew) & (zNew < bi), zNew, (ai + bi) * inv2)
+			convergence = np.minimum(np.abs(zNew - z), np.abs(bi - ai))
+
+		# NaN Ppr, Tpr or bracket: the point stops with z = NaN
+		zn[idx] = np.where(fz == 0.0, z, np.where(fz != fz, fz, zNew))
+		idx = idx[(convergence > epsilon) & (fz != 0.0) & (fz == fz)]
+
+	if (fExit is not None):
+		solverStats.record(method, nIter + nBracket, fExit,
+		                   np.asarray(zb) - np.asarray(za), nBracket)
+	return(zn, nIter)
+
+
+'''
+	Ppr, Tpr    - pseudo reduced pressure and temperature (broadcastable
+	              arrays), the points of a curve follow each other along axis;
+	axis        - axis of the curves (isotherms, isobars or any path);
+	method      - 'newton', 'halley' or 'bisection';
+	extrapolate - predict z linearly from the previous two points of the
+	              curve (finite difference dZ/dPpr along an isotherm, dZ/dTpr
+	              along an isobar) instead of taking the previous z as is;
+	full_output - return the number of residual evaluations per point too;
+	return_status - return the ZSTATUS_* flags per point too.
+	return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS
+	of the broadcast shape, (z, nIter) if full_output, status is appended if
+	return_status.
+	Continuation: the first point of every curve is solved by
+	calcZfactor_DAK_batch, then all the curves step together. Newton and
+	Halley start from the prediction z0 with the safeguard [0.05, 2 z0 - 0.05]
+	(z0 is its midpoint, no residual evaluations for the bracket), a point
+	that ends on the safeguard is solved again from calcBracket_DAK_batch.
+	Bisection takes the bracket z0 +- 2 |last step of z| (calcBracket_DAK_batch
+	checks and widens it). 'newton' runs in the native core when it is built.
+'''
+def calcZfactor_DAK_sweep(Ppr, Tpr, axis = -1, method = 'newton',
+                          extrapolate = True, full_output = False,
+                          return_status = False):
+	if (method != 'newton' and method != 'halley' and method != 'bisection'):
+		raise ValueError('calcZfactor_DAK_sweep(). Unknown method: ' +
+		                 str(method))
+
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+	if (Ppr.ndim == 0):
+		return calcZfactor_DAK_batch(Ppr, Tpr, method = method,
+		                             full_output = full_output,
+		                             return_status = return_status)
+
+	# (points along the curve, curves)
+	moved = np.moveaxis(Ppr, axis, 0).shape
+	P     = np.ascontiguousarray(np.moveaxis(Ppr, axis, 0).reshape(moved[0], -1))
+	T     = np.ascontiguousarray(np.moveaxis(Tpr, axis, 0).reshape(moved[0], -1))
+	z      = np.empty(P.shape)
+	nIter  = np.empty(P.shape, dtype = np.int64)
+	failed = np.empty(P.shape, dtype = np.int8)
+
+	if (method == 'newton' and zfactorCore is not None):
+		fExit = np.empty(P.shape) if (solverStats is not None) else None
+		left  = zfactorCore.zfactor_dak_sweep(P.shape[0], P.shape[1], P, T,
+		                                      int(extrapolate), z, nIter, failed,
+		                                      fExit)
+		if (fExit is not None):
+			recordNativeStats(nIter, fExit, left)
+	else:
+		calcSweep_DAK(P, T, method, extrapolate, z, nIter, failed)
+
+	status = None
+	if (return_status):
+		status = calcStatus_DAK_batch(P, T, z, failed)
+		status = np.moveaxis(status.reshape(moved), 0, axis)
+	z     = np.moveaxis(z.reshape(moved), 0, axis)
+	nIter = np.moveaxis(nIter.reshape(moved), 0, axis)
+	return packResults(z, nIter, status, full_output, return_status)
+
+
+'''
+	P, T        - pseudo reduced pressure and temperature, (points, curves);
+	method      - 'newton', 'halley' or 'bisection';
+	extrapolate - see calcZfactor_DAK_sweep;
+	z, nIter    - out: z and residual evaluations, (points, curves);
+	failed      - out: points whose solve hit the iteration limit.
+	The numpy continuation loop of calcZfactor_DAK_sweep.
+'''
+def calcSweep_DAK(P, T, method, extrapolate, z, nIter, failed):
+	zMin = 0.05
+	eps  = 4.0e-6
+
+	z[0], nIter[0], s = calcZfactor_DAK_batch(P[0], T[0], method = method,
+	                                          full_output = True,
+	                                          return_status = True)
+	failed[0] = (s & ZSTATUS_MAX_ITER) != 0
+	for k in range(1, P.shape[0]):
+		z0 = z[k - 1]
+		if (extrapolate and k > 1):
+			# projection of this step on the previous one
+			dP = P[k - 1] - P[k - 2]
+			dT = T[k - 1] - T[k - 2]
+			h2 = dP*dP + dT*dT
+			h2 = np.where(h2 > 0.0, h2, np.inf)
+			h  = ((P[k] - P[k - 1]) * dP + (T[k] - T[k - 1]) * dT) / h2
+			z0 = z0 + (z[k - 1] - z[k - 2]) * h
+		# After a NaN point the curve starts again from estimateZ_DAK
+		z0 = np.where(z0 != z0, estimateZ_DAK(P[k], T[k]), z0)
+		z0 = np.maximum(z0, 2.0 * zMin)
+
+		if (method == 'bisection'):
+			step = np.abs(z[k - 1] - z[k - 2]) if (k > 1) else 0.005 * z0
+			step = np.where(step != step, 0.005 * z0, step)
+			C1, C2, C3, C4, C5 = calcCoeffs_DAK(P[k], T[k])
+			za, zb, nBracket = calcBracket_DAK_batch(
+				P[k], T[k], C1, C2, C3, C4, C5,
+				np.maximum(2.0 * step / z0, 1.0e-4), z0)
+			z[k], nIter[k], s = calcZfactor_DAK_batch(P[k], T[k], za, zb,
+			                                          method, True, True)
+			nIter[k] += nBracket
+			failed[k] = (s & ZSTATUS_MAX_ITER) != 0
+			continue
+
+		za = zMin
+		zb = 2.0 * z0 - zMin
+		z[k], nIter[k], s = calcZfactor_DAK_batch(P[k], T[k], za, zb, method,
+		                                          True, True)
+		failed[k] = (s & ZSTATUS_MAX_ITER) != 0
+
+		lost = np.flatnonzero((z[k] - za <= eps) | (zb - z[k] <= eps) |
+		                      (z[k] != z[k]))
+		if (lost.size > 0):
+			zi, ni, si = calcZfactor_DAK_batch(P[k, lost], T[k, lost],
+			                                   method = method, full_output = True,
+			                                   return_status = True)
+			z[k, lost]      = zi
+			nIter[k, lost] += ni
+			failed[k, lost] = (si & ZSTATUS_MAX_ITER) != 0
+
+
+'''
+	Ppr    - pseudo reduced pressure, psia;
+	Tpr    - pseudo reduced temperature, K;
+	da, db - dZdT locate [da, db] (bisection method).
+	za, zb - z locate [za, zb] (calcZfactor_DAK);
+	return_status - return the ZSTATUS_* flags of the z and dZ/dTpr solves too.
+	return: dZ/dTpr, (dZ/dTpr, status) if return_status,
+	Z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS.
+'''
+def calc_dZdTpr(Ppr, Tpr, da, db, za = None, zb = None,
+                return_status = False):
+	z, status = calcZfactor_DAK(Ppr, Tpr, za, zb, return_status = True)
+	dRrdT     = 0.27*Ppr / (Tpr*Tpr * z)
+	i         = 0
+	maxIter   = 100
+	inv2      = 0.5
+	epsilon   = 2.0e-6
+	a         = da
+	b         = db
+	dZdTn     = 0.0
+	converged = False
 
 	for i in range(maxIter):
 
 		dZdTn = (a + b) * inv2
 		convergence = abs(b - a)
 		if(convergence <= epsilon):
+			converged = True
 			break
 
 		fz = dZdTn + dRrdT
@@ -134,38 +1567,42 @@ def calc_dZdTpr(Ppr, Tpr, da, db, za = 0.7, zb = 1.1):
 		elif (fz < 0):
 			a = dZdTn
 		elif (fz == 0.0):
+			converged = True
 			break
 
+	if (return_status):
+		return(dZdTn, status | calcStatusBisection(dZdTn, converged, da, db))
 	return dZdTn
 
-	if (i == maxIter - 1):
-		print('calc_dZdTpr(). Warning: max iter!\n')
-
 
 '''
 	Ppr    - pseudo reduced pressure, psia;
 	Tpr    - pseudo reduced temperature, K;
 	da, db - dZdPr locate [da, db] (bisection method).
-	za, zb - z locate [za, zb] (bisection method).
-	return: dZ/dPpr,
+	za, zb - z locate [za, zb] (calcZfactor_DAK);
+	return_status - return the ZSTATUS_* flags of the z and dZ/dPpr solves too.
+	return: dZ/dPpr, (dZ/dPpr, status) if return_status,
 	Z   - gas compressibility factor based on Dranchuk-Abbou Kassem EoS.
 '''
-def calc_dZdPpr(Ppr, Tpr, da, db, za = 0.7, zb = 1.1):
-	z       = calcZfactor_DAK(Ppr, Tpr, za, zb)
-	dRrdPr  = 0.27 / (Tpr * z)
-	i       = 0
-	maxIter = 100
-	inv2    = 0.5
-	epsilon = 2.0e-6
-	a       = da
-	b       = db
-	dZdPrn  = 0.0
+def calc_dZdPpr(Ppr, Tpr, da, db, za = None, zb = None,
+                return_status = False):
+	z, status = calcZfactor_DAK(Ppr, Tpr, za, zb, return_status = True)
+	dRrdPr    = 0.27 / (Tpr * z)
+	i         = 0
+	maxIter   = 100
+	inv2      = 0.5
+	epsilon   = 2.0e-6
+	a         = da
+	b         = db
+	dZdPrn    = 0.0
+	converged = False
 
 	for i in range(maxIter):
 
 		dZdPrn = (a + b) * inv2
 		convergence = abs(b - a)
 		if(convergence <= epsilon):
+			converged = True
 			break
 
 		fz = dZdPrn - dRrdPr
@@ -175,14 +1612,1248 @@ def calc_dZdPpr(Ppr, Tpr, da, db, za = 0.7, zb = 1.1):
 		elif (fz < 0):
 			a = dZdPrn
 		elif (fz == 0.0):
+			converged = True
 			break
 
-	if (i == maxIter - 1):
-		print('calc_dZdPpr(). Warning: max iter!\n')
-
+	if (return_status):
+		return(dZdPrn, status | calcStatusBisection(dZdPrn, converged, da, db))
 	return dZdPrn
 
 
+'''
+	z   - gas compressibility factor (root of the DAK residual);
+	Ppr - pseudo reduced pressure, psia;
+	Tpr - pseudo reduced temperature, K.
+	return: dF/dz, dF/dPpr, dF/dTpr - partial derivatives of the DAK residual
+	(scalars or arrays).
+'''
+def calcResidualDer_DAK(z, Ppr, Tpr):
+	invTpr  = 1.0 / Tpr
+	invTpr2 = invTpr*invTpr
+	invTpr3 = invTpr2*invTpr
+	Rr_z    = 0.27*Ppr * invTpr
+	Rr_z2   = Rr_z*Rr_z
+	dRr_z   = 0.27*Ppr          # d(Rr_z)/d(invTpr)
+
+	A1  = (0.3265 - 1.07 * invTpr - 0.5339 * invTpr3 +
+		  0.01569 * invTpr2*invTpr2 - 0.05165 * invTpr2*invTpr3)
+	dA1 = (-1.07 - 1.6017 * invTpr2 + 0.06276 * invTpr3 -
+		  0.25825 * invTpr2*invTpr2)
+	tmp  = -0.7361 * invTpr + 0.1844 * invTpr2
+	dtmp = -0.7361 + 0.3688 * invTpr
+
+	C1 = A1 * Rr_z
+	C2 = (0.5475 + tmp) * Rr_z2
+	C3 = 0.1056 * tmp * Rr_z2*Rr_z2*Rr_z
+	C4 = 0.6134 * Rr_z2 * invTpr3
+	C5 = 0.7210 * Rr_z2
+
+	# dC/dRr_z, the pressure enters through Rr_z only
+	C1r = A1
+	C2r = 2.0 * (0.5475 + tmp) * Rr_z
+	C3r = 0.528 * tmp * Rr_z2*Rr_z2
+	C4r = 1.2268 * Rr_z * invTpr3
+	C5r = 1.4420 * Rr_z
+
+	# dC/d(invTpr)
+	C1t = dA1 * Rr_z + C1r * dRr_z
+	C2t = dtmp * Rr_z2 + C2r * dRr_z
+	C3t = 0.1056 * dtmp * Rr_z2*Rr_z2*Rr_z + C3r * dRr_z
+	C4t = 1.8402 * Rr_z2 * invTpr2 + C4r * dRr_z
+	C5t = C5r * dRr_z
+
+	# dF/dC
+	invZ  = 1.0 / z
+	invZ2 = invZ*invZ
+	invZ3 = invZ2*invZ
+	t     = C5 * invZ2
+	ex    = np.exp(-t)
+	F1 = -invZ
+	F2 = -invZ2
+	F3 = invZ2*invZ3
+	F4 = -invZ2 * (1.0 + t) * ex
+	F5 = C4 * C5 * invZ3*invZ3 * ex
+
+	dFdz = (1.0 + C1 * invZ2 + 2.0 * C2 * invZ3 - 5.0 * C3 * invZ3*invZ3 +
+		   2.0 * C4 * invZ3 * (1.0 + t - t*t) * ex)
+	dFdRr = F1 * C1r + F2 * C2r + F3 * C3r + F4 * C4r + F5 * C5r
+	dFdt  = F1 * C1t + F2 * C2t + F3 * C3t + F4 * C4t + F5 * C5t
+
+	# d(Rr_z)/dPpr = 0.27/Tpr, d(invTpr)/dTpr = -1/Tpr^2
+	return(dFdz, dFdRr * 0.27 * invTpr, -dFdt * invTpr2)
+
+
+'''
+	z   - gas compressibility factor (root of the DAK residual);
+	Ppr - pseudo reduced pressure, psia;
+	Tpr - pseudo reduced temperature, K.
+	return: dZ/dPpr, dZ/dTpr, d2Z/dPpr2, d2Z/dTpr2, d2Z/dPpr/dTpr
+	(scalars or arrays).
+	The residual is written as F = z - 1 - G(Rr, invTpr), Rr = 0.27*Ppr*invTpr/z
+	is the reduced density, and the second derivatives of the implicit z follow
+	from z_ab = -(F_ab + F_za z_b + F_zb z_a + F_zz z_a z_b) / F_z.
+'''
+def calcImplicitDer2_DAK(z, Ppr, Tpr):
+	t   = 1.0 / Tpr
+	t2  = t*t
+	t3  = t2*t
+	Rr  = 0.27*Ppr * t / z
+	Rr2 = Rr*Rr
+	Rr4 = Rr2*Rr2
+	c   = 0.7210
+
+	# G(Rr, t) = A1 Rr + A2 Rr^2 - A3 Rr^5 + B H(Rr) and its derivatives
+	A1   = 0.3265 - 1.07 * t - 0.5339 * t3 + 0.01569 * t2*t2 - 0.05165 * t2*t3
+	A1t  = -1.07 - 1.6017 * t2 + 0.06276 * t3 - 0.25825 * t2*t2
+	A1tt = -3.2034 * t + 0.18828 * t2 - 1.033 * t3
+	A2   = 0.5475 - 0.7361 * t + 0.1844 * t2
+	A2t  = -0.7361 + 0.3688 * t
+	A2tt = 0.3688
+	A3   = 0.1056 * (-0.7361 * t + 0.1844 * t2)
+	A3t  = 0.1056 * A2t
+	A3tt = 0.1056 * A2tt
+	B    = 0.6134 * t3
+	Bt   = 1.8402 * t2
+	Btt  = 3.6804 * t
+	ex   = np.exp(-c * Rr2)
+	H    = (Rr2 + c * Rr4) * ex
+	Hr   = (2.0 * Rr + 2.0 * c * Rr2*Rr - 2.0 * c*c * Rr4*Rr) * ex
+	Hrr  = (2.0 + 2.0 * c * Rr2 - 14.0 * c*c * Rr4 + 4.0 * c*c*c * Rr4*Rr2) * ex
+
+	Gr  = A1 + 2.0 * A2 * Rr - 5.0 * A3 * Rr4 + B * Hr
+	Grr = 2.0 * A2 - 20.0 * A3 * Rr2*Rr + B * Hrr
+	Gt  = A1t * Rr + A2t * Rr2 - A3t * Rr4*Rr + Bt * H
+	Grt = A1t + 2.0 * A2t * Rr - 5.0 * A3t * Rr4 + Bt * Hr
+	Gtt = A1tt * Rr + A2tt * Rr2 - A3tt * Rr4*Rr + Btt * H
+
+	# Rr(z, Ppr, t) derivatives
+	invZ  = 1.0 / z
+	Rz    = -Rr * invZ
+	Rp    = 0.27 * t * invZ
+	Rt    = 0.27 * Ppr * invZ
+	Rzz   = 2.0 * Rr * invZ*invZ
+	Rzp   = -Rp * invZ
+	Rzt   = -Rt * invZ
+	Rpt   = 0.27 * invZ
+
+	# F(z, Ppr, t) derivatives
+	Fz  = 1.0 - Gr * Rz
+	Fp  = -Gr * Rp
+	Ft  = -Gr * Rt - Gt
+	Fzz = -(Grr * Rz*Rz + Gr * Rzz)
+	Fzp = -(Grr * Rz*Rp + Gr * Rzp)
+	Fzt = -(Grr * Rz*Rt + Grt * Rz + Gr * Rzt)
+	Fpp = -(Grr * Rp*Rp)
+	Fpt = -(Grr * Rp*Rt + Grt * Rp + Gr * Rpt)
+	Ftt = -(Grr * Rt*Rt + 2.0 * Grt * Rt + Gtt)
+
+	invFz = 1.0 / Fz
+	zp    = -Fp * invFz
+	zt    = -Ft * invFz
+	zpp   = -(Fpp + 2.0 * Fzp * zp + Fzz * zp*zp) * invFz
+	ztt   = -(Ftt + 2.0 * Fzt * zt + Fzz * zt*zt) * invFz
+	zpt   = -(Fpt + Fzp * zt + Fzt * zp + Fzz * zp*zt) * invFz
+
+	# t = 1/Tpr: dt/dTpr = -t^2, d2t/dTpr2 = 2 t^3
+	return(zp, -zt * t2, zpp, ztt * t2*t2 + 2.0 * zt * t3, -zpt * t2)
+
+
+'''
+	Ppr    - pseudo reduced pressure, psia;
+	Tpr    - pseudo reduced temperature, K;
+	za, zb - z locate [za, zb], calcBracket_DAK if not given;
+	method - root solver of calcZfactor_DAK;
+	order  - 1 or 2, the highest order of the derivatives.
+	return: z, dZ/dPpr, dZ/dTpr - gas compressibility factor based on
+	Dranchuk-Abbou Kassem EoS and its derivatives, z is solved once and the
+	derivatives follow from the implicit function theorem dZ/dx = -F_x / F_z;
+	order = 2 appends d2Z/dPpr2, d2Z/dTpr2, d2Z/dPpr/dTpr (calcImplicitDer2_DAK).
+'''
+def calcZfactorDer_DAK(Ppr, Tpr, za = None, zb = None, method = 'brent',
+                       order = 1):
+	z = calcZfactor_DAK(Ppr, Tpr, za, zb, method)
+	if (order == 2):
+		return((z,) + calcImplicitDer2_DAK(z, Ppr, Tpr))
+	dFdz, dFdPpr, dFdTpr = calcResidualDer_DAK(z, Ppr, Tpr)
+	return(z, -dFdPpr / dFdz, -dFdTpr / dFdz)
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature (broadcastable arrays);
+	za, zb   - z locate [za, zb], calcBracket_DAK if not given;
+	method   - root solver of calcZfactor_DAK_batch;
+	order    - 1 or 2, the highest order of the derivatives.
+	return: z, dZ/dPpr, dZ/dTpr (and the second derivatives if order = 2) -
+	arrays of the broadcast shape, see calcZfactorDer_DAK.
+'''
+def calcZfactorDer_DAK_batch(Ppr, Tpr, za = None, zb = None, method = 'newton',
+                             order = 1):
+	z = calcZfactor_DAK_batch(Ppr, Tpr, za, zb, method)
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+	if (order == 2):
+		return((z,) + calcImplicitDer2_DAK(z, Ppr, Tpr))
+	dFdz, dFdPpr, dFdTpr = calcResidualDer_DAK(z, Ppr, Tpr)
+	return(z, -dFdPpr / dFdz, -dFdTpr / dFdz)
+
+
+'''
+	Forward mode automatic differentiation number: v - value (scalar or
+	array), d - derivatives of v with respect to the seeded variables,
+	d[k] = dv/dx_k. calcPpc, calcTpc, calcPpr and calcTpr accept it as is,
+	calcZfactor_DAK_AD differentiates the root solve implicitly. numpy
+	operators defer to the reflected ones here (__array_ufunc__ = None), so
+	ndarray op Dual is a Dual and not an object array.
+'''
+class Dual:
+	__array_ufunc__ = None
+
+	def __init__(self, v, d):
+		self.v = v
+		self.d = d
+
+	def __add__(self, other):
+		if (isinstance(other, Dual)):
+			return Dual(self.v + other.v, self.d + other.d)
+		return Dual(self.v + other, self.d)
+
+	__radd__ = __add__
+
+	def __sub__(self, other):
+		if (isinstance(other, Dual)):
+			return Dual(self.v - other.v, self.d - other.d)
+		return Dual(self.v - other, self.d)
+
+	def __rsub__(self, other):
+		return Dual(other - self.v, -self.d)
+
+	def __neg__(self):
+		return Dual(-self.v, -self.d)
+
+	def __mul__(self, other):
+		if (isinstance(other, Dual)):
+			return Dual(self.v * other.v, self.d * other.v + self.v * other.d)
+		return Dual(self.v * other, self.d * other)
+
+	__rmul__ = __mul__
+
+	def __truediv__(self, other):
+		if (isinstance(other, Dual)):
+			inv = 1.0 / other.v
+			return Dual(self.v * inv, (self.d - self.v * inv * other.d) * inv)
+		return Dual(self.v / other, self.d / other)
+
+	def __rtruediv__(self, other):
+		inv = 1.0 / self.v
+		return Dual(other * inv, -other * inv*inv * self.d)
+
+	def __repr__(self):
+		return 'Dual(' + repr(self.v) + ', ' + repr(self.d) + ')'
+
+
+'''
+	x - values of the independent variables (scalars or broadcastable arrays).
+	return: list of Dual, the k-th one is seeded with dx_k/dx_k = 1.
+'''
+def seedDuals(*x):
+	x     = np.broadcast_arrays(*[np.asarray(xi, dtype = float) for xi in x])
+	n     = len(x)
+	duals = []
+	for k in range(n):
+		d    = np.zeros((n,) + x[k].shape)
+		d[k] = 1.0
+		v    = x[k] if (x[k].ndim > 0) else float(x[k])
+		duals.append(Dual(v, d))
+	return duals
+
+
+'''
+	Ppr    - pseudo reduced pressure (Dual);
+	Tpr    - pseudo reduced temperature (Dual, same seeds as Ppr);
+	za, zb - z locate [za, zb], calcBracket_DAK if not given.
+	return: z (Dual) - gas compressibility factor based on DAK EoS, z is solved
+	once on the values and dz = -(F_Ppr dPpr + F_Tpr dTpr) / F_z.
+'''
+def calcZfactor_DAK_AD(Ppr, Tpr, za = None, zb = None):
+	if (np.ndim(Ppr.v) == 0 and np.ndim(Tpr.v) == 0):
+		z = calcZfactor_DAK(Ppr.v, Tpr.v, za, zb)
+	else:
+		z = calcZfactor_DAK_batch(Ppr.v, Tpr.v, za, zb)
+
+	dFdz, dFdPpr, dFdTpr = calcResidualDer_DAK(z, Ppr.v, Tpr.v)
+	return Dual(z, -(dFdPpr * Ppr.d + dFdTpr * Tpr.d) / dFdz)
+
+
+'''
+	P      - pressure, atm;
+	T      - temperature, °C;
+	sg     - specific gravity (0.57 < sg < 1.68);
+	za, zb - z locate [za, zb], calcBracket_DAK if not given.
+	return: z, dz/dP, dz/dT, dz/dsg in one pass through
+	calcPpc, calcTpc, calcPpr, calcTpr and calcZfactor_DAK.
+'''
+def calcZfactorPTsg_AD(P, T, sg, za = None, zb = None):
+	P, T, sg = seedDuals(P, T, sg)
+	z = calcZfactor_DAK_AD(calcPpr(P, sg), calcTpr(T, sg), za, zb)
+	return(z.v, z.d[0], z.d[1], z.d[2])
+
+
+'''
+	Properties of calcGasProperties, arrays of the broadcast shape of (P, T, sg):
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	z        - gas compressibility factor based on Dranchuk-Abbou Kassem EoS;
+	Bg       - formation volume factor, m3/sm3 (standard conditions 1 atm, 60 °F);
+	rho      - density, kg/m3;
+	cg       - isothermal compressibility, 1/atm;
+	mu       - viscosity (Lee-Gonzalez-Eakin), cP.
+'''
+GasProperties = collections.namedtuple('GasProperties',
+                                       ['Ppr', 'Tpr', 'z', 'Bg', 'rho', 'cg', 'mu'])
+
+
+'''
+	P      - pressure, atm;
+	T      - temperature, °C;
+	sg     - specific gravity (0.57 < sg < 1.68);
+	za, zb - z locate [za, zb], calcBracket_DAK if not given.
+	return: GasProperties, Ppc/Tpc are evaluated once and z with dZ/dPpr is
+	solved once for all the properties.
+'''
+def calcGasProperties(P, T, sg, za = None, zb = None):
+	P, T, sg = np.broadcast_arrays(np.asarray(P, dtype = float),
+	                               np.asarray(T, dtype = float),
+	                               np.asarray(sg, dtype = float))
+
+	# 1 (atm) = 1*101325/6894.757293168 (psia).
+	atm2psia = 101325 / 6894.757293168
+	Ppc      = calcPpc(sg)
+	Ppr      = P * atm2psia / Ppc
+	TK       = T + 273.15
+	Tpr      = TK / calcTpc(sg)
+
+	z, dZdPpr = calcZfactorDer_DAK_batch(Ppr, Tpr, za, zb)[:2]
+
+	# Standard conditions: 1 atm, 60 °F = 288.706 K.
+	Bg  = z * TK / (P * 288.706)
+	# M = 28.97*sg g/mol, R = 8.314462618 J/(mol K).
+	M   = 28.97 * sg
+	rho = P * 101325 * M * 1.0e-3 / (z * 8.314462618 * TK)
+	# cg = 1/P - (1/z) dZ/dP.
+	cg  = 1.0 / P - dZdPpr / z * atm2psia / Ppc
+
+	# Lee-Gonzalez-Eakin: T in °R, density in g/cm3.
+	TR = TK * 1.8
+	K  = (9.4 + 0.02 * M) * TR**1.5 / (209.0 + 19.0 * M + TR)
+	X  = 3.5 + 986.0 / TR + 0.01 * M
+	Y  = 2.4 - 0.2 * X
+	mu = 1.0e-4 * K * np.exp(X * (rho * 1.0e-3)**Y)
+
+	return GasProperties(Ppr, Tpr, z, Bg, rho, cg, mu)
+
+
+'''
+	Bicubic z-factor table over the (Ppr, Tpr) plane (buildZTable_DAK):
+	PprMin, hPpr, nPpr - first node, step and node count along Ppr;
+	TprMin, hTpr, nTpr - the same along Tpr;
+	coeffs             - (nTpr - 1)*(nPpr - 1) x 16 bicubic coefficients of the
+	                     cells (row major in Tpr), a_kl at [4*k + l] for u^k v^l,
+	                     the 16 of a cell are adjacent (2 cache lines a lookup);
+	maxError           - max |z_table - z_DAK| over the verification points;
+	bandError          - the same per band of cells along Tpr (nTpr - 1),
+	                     band j is TprMin + j*hTpr <= Tpr <= TprMin + (j+1)*hTpr.
+'''
+ZTable = collections.namedtuple('ZTable', ['PprMin', 'hPpr', 'nPpr', 'TprMin',
+                                           'hTpr', 'nTpr', 'coeffs', 'maxError',
+                                           'bandError'])
+
+
+'''
+	f, fP, fT, fPT - values and derivatives (scaled by the cell size) at the
+	corners of the cells, each a tuple (P0T0, P1T0, P0T1, P1T1) of arrays.
+	return: cells x 16 bicubic Hermite coefficients, a_kl at [4*k + l] for
+	u^k v^l, u and v are the local Ppr and Tpr coordinates in [0, 1].
+'''
+def calcBicubicCoeffs(f, fP, fT, fPT):
+	# F[a, b]: a - value/derivative at the left/right Ppr node,
+	# b - value/derivative at the lower/upper Tpr node.
+	F = np.stack([np.stack([f[0],  f[2],  fT[0],  fT[2]],  -1),
+	              np.stack([f[1],  f[3],  fT[1],  fT[3]],  -1),
+	              np.stack([fP[0], fP[2], fPT[0], fPT[2]], -1),
+	              np.stack([fP[1], fP[3], fPT[1], fPT[3]], -1)], -2)
+	M = np.array([[ 1.0,  0.0,  0.0,  0.0],
+	              [ 0.0,  0.0,  1.0,  0.0],
+	              [-3.0,  3.0, -2.0, -1.0],
+	              [ 2.0, -2.0,  1.0,  1.0]])
+	A = np.einsum('ab,...bc,dc->...ad', M, F, M)
+	return np.ascontiguousarray(A.reshape(-1, 16))
+
+
+'''
+	c    - 16 coefficient arrays of the bicubic patches (the transposed
+	       calcBicubicCoeffs);
+	u, v - local Ppr and Tpr coordinates.
+	return: value of the patches at (u, v).
+'''
+def evalBicubic(c, u, v):
+	z = 0.0
+	for k in range(3, -1, -1):
+		row = ((c[4*k + 3] * v + c[4*k + 2]) * v + c[4*k + 1]) * v + c[4*k]
+		z   = z * u + row
+	return z
+
+
+'''
+	PprMin, PprMax - Ppr range of the table;
+	TprMin, TprMax - Tpr range of the table;
+	nPpr, nTpr     - number of nodes;
+	za, zb         - z locate [za, zb] for the node solves.
+	return: ZTable. The nodes store z, dZ/dPpr, dZ/dTpr and d2Z/dPpr/dTpr
+	(calcZfactorDer_DAK_batch), each cell is a bicubic Hermite patch. maxError
+	and bandError are measured against calcZfactor_DAK_batch at the cell
+	centres and the midpoints of the cell edges, where the interpolation error
+	peaks. Near Tpr = 1 (Ppr ~ 1) the DAK isotherms turn sharply (the
+	multi-root pocket) and the error there sets maxError (0.14 with the
+	defaults), bandError shows where the table is good enough: with the
+	defaults below 1e-5 for Tpr > 1.2.
+'''
+def buildZTable_DAK(PprMin = 0.2, PprMax = 30.0, TprMin = 1.0, TprMax = 3.0,
+                    nPpr = 150, nTpr = 101, za = 0.05, zb = 5.0):
+	Ppr  = np.linspace(PprMin, PprMax, nPpr)
+	Tpr  = np.linspace(TprMin, TprMax, nTpr)
+	hPpr = Ppr[1] - Ppr[0]
+	hTpr = Tpr[1] - Tpr[0]
+
+	z, zP, zT, zPP, zTT, zPT = calcZfactorDer_DAK_batch(
+		Ppr[np.newaxis, :], Tpr[:, np.newaxis], za, zb, order = 2)
+
+	def corners(f):
+		return(f[:-1, :-1], f[:-1, 1:], f[1:, :-1], f[1:, 1:])
+
+	coeffs = calcBicubicCoeffs(corners(z), corners(zP * hPpr),
+	                           corners(zT * hTpr), corners(zPT * hPpr * hTpr))
+
+	table = ZTable(PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, coeffs, 0.0, None)
+
+	# Verification: cell centres and edge midpoints
+	PprH = np.linspace(PprMin, PprMax, 2 * nPpr - 1)
+	TprH = np.linspace(TprMin, TprMax, 2 * nTpr - 1)
+	zH   = calcZfactor_DAK_batch(PprH[np.newaxis, :], TprH[:, np.newaxis], za, zb)
+	err  = np.abs(calcZfactor_table(table, PprH[np.newaxis, :],
+	                                TprH[:, np.newaxis]) - zH)
+	# band j holds the verification rows 2j..2j+2
+	row  = err.max(axis = 1)
+	band = np.maximum(np.maximum(row[0:-2:2], row[1::2]), row[2::2])
+	return table._replace(maxError = float(err.max()), bandError = band)
+
+
+'''
+	table    - ZTable (buildZTable_DAK);
+	Ppr, Tpr - pseudo reduced pressure and temperature (broadcastable arrays).
+	return: z - gas compressibility factor interpolated from the table, points
+	outside the table are extrapolated from the edge cells. Runs in the native
+	core when it is built.
+'''
+def calcZfactor_table(table, Ppr, Tpr):
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+
+	if (zfactorCore is not None):
+		z = np.empty(Ppr.size)
+		zfactorCore.zfactor_table_eval(
+			Ppr.size, np.ascontiguousarray(Ppr.ravel()),
+			np.ascontiguousarray(Tpr.ravel()), table.PprMin, table.hPpr,
+			table.nPpr, table.TprMin, table.hTpr, table.nTpr, table.coeffs, z)
+		return z.reshape(Ppr.shape)
+
+	x = (Ppr.ravel() - table.PprMin) / table.hPpr
+	y = (Tpr.ravel() - table.TprMin) / table.hTpr
+	i = np.clip(np.floor(x), 0, table.nPpr - 2).astype(np.intp)
+	j = np.clip(np.floor(y), 0, table.nTpr - 2).astype(np.intp)
+	u = x - i
+	v = y - j
+	n = j * (table.nPpr - 1) + i
+	c = table.coeffs.take(n, axis = 0).T
+
+	return evalBicubic(c, u, v).reshape(Ppr.shape)
+
+
+'''
+	Binary z-factor table file (saveZTable/loadZTable), little endian:
+	  0  magic 'ZFTABLE\0'
+	  8  uint32 version, uint32 correlation id (1 - Dranchuk-Abbou Kassem),
+	     uint32 table kind (1 - uniform bicubic, ZTable), uint32 reserved
+	 24  float64 PprMin, hPpr, TprMin, hTpr, sg (0 - reduced, any gas), maxError
+	 72  int64 nPpr, nTpr
+	 88  uint32 CRC-32 of the coefficients, zero padding
+	128  float64 coefficients, (nTpr - 1)*(nPpr - 1) x 16 (ZTable.coeffs, a
+	     cell is 2 cache lines of the mapped file)
+	     float64 bandError, nTpr - 1 (version 2)
+'''
+ZTABLE_MAGIC   = b'ZFTABLE\0'
+ZTABLE_VERSION = 2
+ZTABLE_HEADER  = struct.Struct('<8s4I6d2qI')
+ZTABLE_OFFSET  = 128
+CORRELATION_DAK = 1
+TABLE_BICUBIC   = 1
+
+
+'''
+	table - ZTable (buildZTable_DAK);
+	path  - file name;
+	sg    - specific gravity the table is made for, 0 for the reduced table.
+	The file is written next to path and renamed, so a reader never maps a
+	partially written table.
+'''
+def saveZTable(table, path, sg = 0.0):
+	coeffs = np.ascontiguousarray(table.coeffs, dtype = '<f8')
+	header = ZTABLE_HEADER.pack(ZTABLE_MAGIC, ZTABLE_VERSION, CORRELATION_DAK,
+	                            TABLE_BICUBIC, 0, table.PprMin, table.hPpr,
+	                            table.TprMin, table.hTpr, sg, table.maxError,
+	                            table.nPpr, table.nTpr,
+	                            zlib.crc32(coeffs.tobytes()))
+
+	tmp = path + '.tmp' + str(os.getpid())
+	with open(tmp, 'wb') as f:
+		f.write(header.ljust(ZTABLE_OFFSET, b'\0'))
+		f.write(coeffs.tobytes())
+		f.write(np.ascontiguousarray(table.bandError, dtype = '<f8').tobytes())
+	os.replace(tmp, path)
+
+
+'''
+	path   - file name (saveZTable);
+	sg     - expected specific gravity, None - any;
+	verify - check the CRC-32 of the coefficients (reads the whole file).
+	return: ZTable, its coefficients are a read-only memory map of the file,
+	so loading is O(1) and processes on a node share the pages.
+'''
+def loadZTable(path, sg = None, verify = False):
+	with open(path, 'rb') as f:
+		header = f.read(ZTABLE_HEADER.size)
+	if (len(header) < ZTABLE_HEADER.size):
+		raise ValueError('loadZTable(). Truncated header: ' + path)
+
+	(magic, version, correlation, kind, reserved, PprMin, hPpr, TprMin, hTpr,
+	 tableSg, maxError, nPpr, nTpr, crc) = ZTABLE_HEADER.unpack(header)
+
+	if (magic != ZTABLE_MAGIC or version != ZTABLE_VERSION):
+		raise ValueError('loadZTable(). Not a z-factor table of version ' +
+		                 str(ZTABLE_VERSION) + ': ' + path)
+	if (correlation != CORRELATION_DAK or kind != TABLE_BICUBIC):
+		raise ValueError('loadZTable(). Unsupported correlation/kind: ' + path)
+	if (sg is not None and abs(sg - tableSg) > 1.0e-12):
+		raise ValueError('loadZTable(). Table is made for sg = ' + str(tableSg))
+
+	cells  = (nPpr - 1) * (nTpr - 1)
+	coeffs = np.memmap(path, dtype = '<f8', mode = 'r', offset = ZTABLE_OFFSET,
+	                   shape = (cells, 16))
+	if (verify and zlib.crc32(coeffs.tobytes()) != crc):
+		raise ValueError('loadZTable(). Checksum mismatch: ' + path)
+	bandError = np.fromfile(path, dtype = '<f8', count = nTpr - 1,
+	                        offset = ZTABLE_OFFSET + cells * 16 * 8)
+	if (bandError.size != nTpr - 1):
+		raise ValueError('loadZTable(). Truncated file: ' + path)
+
+	return ZTable(PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, coeffs, maxError,
+	              bandError)
+
+
+'''
+	P - pressure, atm (array);
+	T - temperature, °C (array, broadcastable with P).
+	return: z - gas compressibility factor interpolated from the table baked
+	into the native core at compile time (zfactor_table_ct.h, the gas and the
+	(P, T) grid are set by the ZF_CT_* macros, see calcZfactorCompiledDomain).
+'''
+def calcZfactor_compiled(P, T):
+	if (zfactorCore is None):
+		raise RuntimeError('calcZfactor_compiled(). Native core is not built.')
+
+	P, T = np.broadcast_arrays(np.asarray(P, dtype = float),
+	                           np.asarray(T, dtype = float))
+	z = np.empty(P.size)
+	zfactorCore.zfactor_ct_eval(P.size, np.ascontiguousarray(P.ravel()),
+	                            np.ascontiguousarray(T.ravel()), z)
+	return z.reshape(P.shape)
+
+
+'''
+	return: sg, (Pmin, Pmax), (Tmin, Tmax), (nP, nT) of the compile-time table.
+'''
+def calcZfactorCompiledDomain():
+	if (zfactorCore is None):
+		raise RuntimeError('calcZfactorCompiledDomain(). Native core is not built.')
+
+	d = np.empty(7)
+	zfactorCore.zfactor_ct_domain(d)
+	return(d[0], (d[1], d[2]), (d[3], d[4]), (int(d[5]), int(d[6])))
+
+
+'''
+	Adaptive (quadtree) bicubic z-factor table (buildZTableAdaptive_DAK):
+	PprMin, hPpr, nPpr - first node, cell size and cell count of the base grid
+	                     along Ppr;
+	TprMin, hTpr, nTpr - the same along Tpr;
+	child              - per tree node: index of the first of its 4 children
+	                     (ordered by 2*(upper Tpr half) + (upper Ppr half)),
+	                     or -(leaf + 1); nodes 0..nPpr*nTpr - 1 are the base
+	                     cells, row major in Tpr;
+	coeffs             - leaves x 16 bicubic coefficients (calcBicubicCoeffs),
+	                     the 16 of a leaf are adjacent (2 cache lines a
+	                     lookup);
+	depth              - depth of the deepest leaf;
+	maxError           - max |z_table - z_DAK| over the verification points.
+'''
+ZTableAdaptive = collections.namedtuple('ZTableAdaptive',
+                                        ['PprMin', 'hPpr', 'nPpr', 'TprMin',
+                                         'hTpr', 'nTpr', 'child', 'coeffs',
+                                         'depth', 'maxError'])
+
+
+'''
+	PprMin, PprMax - Ppr range of the table;
+	TprMin, TprMax - Tpr range of the table;
+	nPpr, nTpr     - number of base grid cells;
+	tolerance      - target interpolation error;
+	maxDepth       - max subdivisions of a base cell;
+	za, zb         - z locate [za, zb] for the solves.
+	return: ZTableAdaptive. A cell is a bicubic Hermite patch over its corners
+	(as in buildZTable_DAK), its error is checked against calcZfactor_DAK_batch
+	at the centre and the edge midpoints, and the cell is split in four until
+	the error is below tolerance or maxDepth is reached (the near critical
+	corner Tpr ~ 1, Ppr ~ 1 may stop there, see maxError).
+'''
+def buildZTableAdaptive_DAK(PprMin = 0.2, PprMax = 30.0, TprMin = 1.0,
+                            TprMax = 3.0, nPpr = 8, nTpr = 4,
+                            tolerance = 1.0e-5, maxDepth = 10,
+                            za = 0.05, zb = 5.0):
+	hPpr = (PprMax - PprMin) / nPpr
+	hTpr = (TprMax - TprMin) / nTpr
+
+	# Cells of the current level: lower left corner, size and tree node
+	j, i  = np.divmod(np.arange(nPpr * nTpr), nPpr)
+	x0    = PprMin + i * hPpr
+	y0    = TprMin + j * hTpr
+	hx    = np.full(x0.size, hPpr)
+	hy    = np.full(x0.size, hTpr)
+	node  = np.arange(x0.size)
+	child = [np.zeros(x0.size, dtype = np.int32)]
+	nNode = x0.size
+
+	coeffs   = []
+	nLeaf    = 0
+	depth    = 0
+	maxError = 0.0
+
+	# Corners (P0T0, P1T0, P0T1, P1T1) and the verification points
+	cu = np.array([0.0, 1.0, 0.0, 1.0])
+	cv = np.array([0.0, 0.0, 1.0, 1.0])
+	vu = np.array([0.5, 0.5, 0.5, 0.0, 1.0])
+	vv = np.array([0.5, 0.0, 1.0, 0.5, 0.5])
+
+	for level in range(maxDepth + 1):
+		Ppr = x0[:, np.newaxis] + hx[:, np.newaxis] * cu
+		Tpr = y0[:, np.newaxis] + hy[:, np.newaxis] * cv
+		z, zP, zT, zPP, zTT, zPT = calcZfactorDer_DAK_batch(Ppr, Tpr, za, zb,
+		                                                    order = 2)
+		hxc = hx[:, np.newaxis]
+		hyc = hy[:, np.newaxis]
+		c   = calcBicubicCoeffs(tuple(z.T), tuple((zP * hxc).T),
+		                        tuple((zT * hyc).T), tuple((zPT * hxc * hyc).T))
+
+		Ppr = x0[:, np.newaxis] + hx[:, np.newaxis] * vu
+		Tpr = y0[:, np.newaxis] + hy[:, np.newaxis] * vv
+		zV  = calcZfactor_DAK_batch(Ppr, Tpr, za, zb)
+		err = np.abs(evalBicubic(c.T[:, :, np.newaxis], vu, vv) -
+		             zV).max(axis = 1)
+
+		split = (err > tolerance) & (level < maxDepth)
+		leaf  = ~split
+		depth = level
+
+		# Leaves
+		nNew = int(leaf.sum())
+		child[0][node[leaf]] = -(nLeaf + np.arange(nNew) + 1)
+		coeffs.append(c[leaf])
+		nLeaf += nNew
+		if (nNew > 0):
+			maxError = max(maxError, float(err[leaf].max()))
+
+		# Inner nodes: 4 consecutive children each
+		nSplit = int(split.sum())
+		if (nSplit == 0):
+			break
+		first = nNode + 4 * np.arange(nSplit)
+		child[0][node[split]] = first
+		child[0] = np.concatenate([child[0],
+		                           np.zeros(4 * nSplit, dtype = np.int32)])
+		nNode += 4 * nSplit
+
+		qx   = np.tile([0.0, 1.0, 0.0, 1.0], nSplit)
+		qy   = np.tile([0.0, 0.0, 1.0, 1.0], nSplit)
+		hx   = np.repeat(hx[split] * 0.5, 4)
+		hy   = np.repeat(hy[split] * 0.5, 4)
+		x0   = np.repeat(x0[split], 4) + qx * hx
+		y0   = np.repeat(y0[split], 4) + qy * hy
+		node = np.repeat(first, 4) + np.tile(np.arange(4), nSplit)
+
+	return ZTableAdaptive(PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, child[0],
+	                      np.ascontiguousarray(np.concatenate(coeffs, 0)),
+	                      depth, maxError)
+
+
+'''
+	table    - ZTableAdaptive (buildZTableAdaptive_DAK);
+	Ppr, Tpr - pseudo reduced pressure and temperature (broadcastable arrays).
+	return: z - gas compressibility factor interpolated from the table, points
+	outside the table are extrapolated from the edge cells. Runs in the native
+	core when it is built.
+'''
+def calcZfactor_tableAdaptive(table, Ppr, Tpr):
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+
+	if (zfactorCore is not None):
+		z = np.empty(Ppr.size)
+		zfactorCore.zfactor_quadtree_eval(
+			Ppr.size, np.ascontiguousarray(Ppr.ravel()),
+			np.ascontiguousarray(Tpr.ravel()), table.PprMin, table.hPpr,
+			table.nPpr, table.TprMin, table.hTpr, table.nTpr, table.child,
+			table.coeffs, z)
+		return z.reshape(Ppr.shape)
+
+	x = (Ppr.ravel() - table.PprMin) / table.hPpr
+	y = (Tpr.ravel() - table.TprMin) / table.hTpr
+	i = np.clip(np.floor(x), 0, table.nPpr - 1).astype(np.intp)
+	j = np.clip(np.floor(y), 0, table.nTpr - 1).astype(np.intp)
+	u = x - i
+	v = y - j
+	n = j * table.nPpr + i
+
+	# Descend to the leaves, a level per step
+	for level in range(table.depth):
+		c     = table.child.take(n)
+		inner = c >= 0
+		if (not inner.any()):
+			break
+		qx = (u >= 0.5) & inner
+		qy = (v >= 0.5) & inner
+		n  = np.where(inner, c + 2 * qy + qx, n)
+		u  = np.where(inner, 2.0 * u - qx, u)
+		v  = np.where(inner, 2.0 * v - qy, v)
+
+	n = -table.child.take(n) - 1
+	c = table.coeffs.take(n, axis = 0).T
+
+	return evalBicubic(c, u, v).reshape(Ppr.shape)
+
+
+'''
+	Piecewise polynomial z-factor surrogate (buildZChebyshev_DAK):
+	PprMin, hPpr, nPpr - first node, tile size and tile count along Ppr;
+	TprMin, hTpr, nTpr - the same along Tpr;
+	degP, degT         - polynomial degree along Ppr and Tpr;
+	coeffs             - tiles x (degP + 1)*(degT + 1) monomial coefficients in
+	                     the local coordinates s, t in [-1, 1], a_kl at
+	                     [(degT + 1)*k + l] for s^k t^l, tiles row major in Tpr
+	                     (the coefficients of a tile are contiguous);
+	maxError, rmsError - per tile max and RMS |z_surrogate - z_DAK| over the
+	                     verification samples (arrays nTpr x nPpr).
+'''
+ZChebyshev = collections.namedtuple('ZChebyshev',
+                                    ['PprMin', 'hPpr', 'nPpr', 'TprMin', 'hTpr',
+                                     'nTpr', 'degP', 'degT', 'coeffs',
+                                     'maxError', 'rmsError'])
+
+
+'''
+	c          - (degP + 1)*(degT + 1) coefficient arrays, a_kl at
+	             [(degT + 1)*k + l] for u^k v^l;
+	degP, degT - polynomial degree along u and v;
+	u, v       - local coordinates.
+	return: value of the polynomials at (u, v), Horner scheme (FMA only).
+'''
+def evalPoly2D(c, degP, degT, u, v):
+	z = 0.0
+	for k in range(degP, -1, -1):
+		row = c[(degT + 1)*k + degT]
+		for l in range(degT - 1, -1, -1):
+			row = row * v + c[(degT + 1)*k + l]
+		z = z * u + row
+	return z
+
+
+'''
+	PprMin, PprMax - Ppr range of the surrogate;
+	TprMin, TprMax - Tpr range of the surrogate;
+	nPpr, nTpr     - number of tiles;
+	degP, degT     - polynomial degree along Ppr and Tpr;
+	nCheck         - verification samples per tile along each axis;
+	za, zb         - z locate [za, zb] for the solves.
+	return: ZChebyshev. On every tile z is interpolated at the Chebyshev nodes
+	(tensor product), the Chebyshev series is converted to monomials for the
+	Horner evaluation, and the tile is verified on an nCheck x nCheck uniform
+	sample against the bisection solver of calcZfactor_DAK_batch (which is
+	accurate to 1e-6, the floor of the reported errors).
+'''
+def buildZChebyshev_DAK(PprMin = 0.2, PprMax = 30.0, TprMin = 1.0,
+                        TprMax = 3.0, nPpr = 16, nTpr = 16, degP = 9,
+                        degT = 9, nCheck = 16, za = 0.05, zb = 5.0):
+	hPpr = (PprMax - PprMin) / nPpr
+	hTpr = (TprMax - TprMin) / nTpr
+
+	# Chebyshev nodes, T_k at the nodes and T_k in monomials of [-1, 1]
+	def chebyshev(deg):
+		n  = deg + 1
+		x  = np.cos(np.pi * (np.arange(n) + 0.5) / n)
+		Tk = np.polynomial.chebyshev.chebvander(x, deg).T * (2.0 / n)
+		Tk[0] *= 0.5
+		Q  = np.zeros((n, n))
+		for k in range(n):
+			e    = np.zeros(n)
+			e[k] = 1.0
+			p    = np.polynomial.chebyshev.cheb2poly(e)
+			Q[k, :p.size] = p
+		return(x, Tk, Q)
+
+	xP, TP, QP = chebyshev(degP)
+	xT, TT, QT = chebyshev(degT)
+
+	i0  = np.arange(nPpr) * hPpr + PprMin
+	j0  = np.arange(nTpr) * hTpr + TprMin
+	Ppr = i0[np.newaxis, :, np.newaxis, np.newaxis] + (xP + 1.0) * 0.5 * hPpr
+	Tpr = j0[:, np.newaxis, np.newaxis, np.newaxis] + \
+	      (xT[:, np.newaxis] + 1.0) * 0.5 * hTpr
+	# z[jTile, iTile, mT, mP]
+	z = calcZfactor_DAK_batch(Ppr, Tpr, za, zb)
+
+	# Chebyshev coefficients C[.., kP, kT], then monomial ones A[.., kP, kT]
+	C = np.einsum('pm,...nm,tn->...pt', TP, z, TT)
+	A = np.einsum('pa,...pt,tb->...ab', QP, C, QT)
+	coeffs = np.ascontiguousarray(A.reshape(nPpr * nTpr, -1))
+
+	table = ZChebyshev(PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, degP, degT,
+	                   coeffs, None, None)
+
+	# Verification: uniform nCheck x nCheck sample inside every tile
+	s   = (np.arange(nCheck) + 0.5) / nCheck
+	Ppr = i0[np.newaxis, :, np.newaxis, np.newaxis] + s * hPpr
+	Tpr = j0[:, np.newaxis, np.newaxis, np.newaxis] + s[:, np.newaxis] * hTpr
+	zV  = calcZfactor_DAK_batch(Ppr, Tpr, za, zb, method = 'bisection')
+	err = np.abs(calcZfactor_Chebyshev(table, Ppr, Tpr) - zV)
+
+	return table._replace(maxError = err.max(axis = (2, 3)),
+	                      rmsError = np.sqrt((err*err).mean(axis = (2, 3))))
+
+
+'''
+	table    - ZChebyshev (buildZChebyshev_DAK);
+	Ppr, Tpr - pseudo reduced pressure and temperature (broadcastable arrays).
+	return: z - gas compressibility factor of the surrogate, points outside the
+	range are extrapolated from the edge tiles. Runs in the native core when it
+	is built.
+'''
+def calcZfactor_Chebyshev(table, Ppr, Tpr):
+	Ppr, Tpr = np.broadcast_arrays(np.asarray(Ppr, dtype = float),
+	                               np.asarray(Tpr, dtype = float))
+
+	if (zfactorCore is not None):
+		z = np.empty(Ppr.size)
+		zfactorCore.zfactor_poly_eval(
+			Ppr.size, np.ascontiguousarray(Ppr.ravel()),
+			np.ascontiguousarray(Tpr.ravel()), table.PprMin, table.hPpr,
+			table.nPpr, table.TprMin, table.hTpr, table.nTpr, table.degP,
+			table.degT, table.coeffs, z)
+		return z.reshape(Ppr.shape)
+
+	x = (Ppr.ravel() - table.PprMin) / table.hPpr
+	y = (Tpr.ravel() - table.TprMin) / table.hTpr
+	i = np.clip(np.floor(x), 0, table.nPpr - 1).astype(np.intp)
+	j = np.clip(np.floor(y), 0, table.nTpr - 1).astype(np.intp)
+	n = j * table.nPpr + i
+	c = table.coeffs.take(n, axis = 0).T
+
+	return evalPoly2D(c, table.degP, table.degT, 2.0 * (x - i) - 1.0,
+	                  2.0 * (y - j) - 1.0).reshape(Ppr.shape)
+
+
+'''
+	points - (Ppr, Tpr) pairs;
+	call   - function of (Ppr, Tpr) being timed;
+	warmup - untimed passes over the points;
+	repeat - timed passes.
+	return: times - seconds of every timed pass (time.perf_counter).
+'''
+def benchTimes(points, call, warmup, repeat):
+	for k in range(warmup):
+		for Ppr, Tpr in points:
+			call(Ppr, Tpr)
+
+	times = np.empty(repeat)
+	for k in range(repeat):
+		startTime = time.perf_counter()
+		for Ppr, Tpr in points:
+			call(Ppr, Tpr)
+		times[k] = time.perf_counter() - startTime
+	return times
+
+
+'''
+	return: dict of the machine a benchmark runs on (ISA of the native core,
+	numpy, python, cores, solverStats recording, date).
+'''
+def benchMachine():
+	return {'isa': (zfactorCore.zfactor_isa().decode()
+	                if (zfactorCore is not None) else 'numpy'),
+	        'numpy': np.__version__, 'python': platform.python_version(),
+	        'machine': platform.machine(), 'cpus': os.cpu_count(),
+	        'solverStats': solverStats is not None,
+	        'date': time.strftime('%Y-%m-%dT%H:%M:%S')}
+
+
+'''
+	records - benchmark records;
+	path    - output file, one JSON line per record is appended (None to
+	          skip).
+'''
+def writeBenchRecords(records, path):
+	if (path is not None):
+		with open(path, 'a') as f:
+			for record in records:
+				f.write(json.dumps(record) + '\n')
+
+
+'''
+	Functions of benchmark(): the brackets of the derivatives are those of
+	test3.
+'''
+BENCH_FUNCTIONS = collections.OrderedDict([
+	('calcZfactor_DAK', lambda Ppr, Tpr: calcZfactor_DAK(Ppr, Tpr)),
+	('calc_dZdTpr',     lambda Ppr, Tpr: calc_dZdTpr(Ppr, Tpr, -16, -2.5e-2)),
+	('calc_dZdPpr',     lambda Ppr, Tpr: calc_dZdPpr(Ppr, Tpr, 2.5e-2, 16))])
+
+
+'''
+	nP, nT       - grid nodes along P and T;
+	PMin, PMax   - pressure range, atm;
+	TMin, TMax   - temperature range, °C;
+	sg           - specific gravity of the gas;
+	warmup       - untimed passes over the grid;
+	repeat       - timed passes;
+	functions    - names of BENCH_FUNCTIONS to time;
+	path         - output file, one JSON line per function is appended (None
+	               to skip);
+	percentiles  - reported percentiles of the pass time.
+	return: list of the records, pass times in seconds, points per second of
+	the median pass. The machine (ISA of the native core, numpy, python) is
+	recorded too, the runs in path can be compared across releases.
+'''
+def benchmark(nP = 50, nT = 20, PMin = 1.0, PMax = 500.0, TMin = -30.0,
+              TMax = 200.0, sg = 0.661, warmup = 2, repeat = 10,
+              functions = tuple(BENCH_FUNCTIONS), path = 'bench_output.txt',
+              percentiles = (50, 90, 99)):
+	Ppr    = calcPpr(np.linspace(PMin, PMax, nP), sg)
+	Tpr    = calcTpr(np.linspace(TMin, TMax, nT), sg)
+	if (isinstance(functions, str)):
+		functions = (functions,)
+	points  = [(float(p), float(t)) for t in Tpr for p in Ppr]
+	machine = benchMachine()
+
+	records = []
+	for name in functions:
+		times = benchTimes(points, BENCH_FUNCTIONS[name], warmup, repeat)
+		pct   = np.percentile(times, percentiles)
+		record = {'benchmark': 'solvers', 'function': name, 'nP': nP, 'nT': nT,
+		          'P': [PMin, PMax], 'T': [TMin, TMax], 'sg': sg,
+		          'points': len(points), 'warmup': warmup, 'repeat': repeat,
+		          'min': float(times.min()), 'max': float(times.max()),
+		          'mean': float(times.mean()), 'std': float(times.std())}
+		for q, t in zip(percentiles, pct):
+			record['p' + str(q)] = float(t)
+		record['pointsPerSecond'] = len(points) / float(np.median(times))
+		record.update(machine)
+		records.append(record)
+
+		print('{:16s} {:8d} points  median {:.6f} s  p{} {:.6f} s  '
+		      '{:.0f} points/s'.format(name, len(points),
+		      float(np.median(times)), percentiles[-1], float(pct[-1]),
+		      record['pointsPerSecond']))
+
+	writeBenchRecords(records, path)
+	return records
+
+
+'''
+	threads       - numbers of threads, powers of two up to min(64, cores) if
+	                not given;
+	sizes         - batch sizes, points;
+	repeat        - timed passes per (threads, size);
+	minPoints     - a pass evaluates the batch ceil(minPoints / size) times,
+	                small batches are not timed below the clock resolution;
+	seed          - seed of the points, uniform in the DAK range
+	                (0.2 <= Ppr <= 30, 1 <= Tpr <= 3);
+	path          - output file, one JSON line per (threads, size) is
+	                appended (None to skip);
+	bytesPerPoint - memory traffic of a point: Ppr, Tpr read, z, nIter
+	                written;
+	chunk         - points per chunk of the thread pool.
+	return: list of the records: median pass time, points per second,
+	parallel efficiency (throughput / (threads * throughput of 1 thread at the
+	same size)) and memory bandwidth (bytesPerPoint * points per second, the
+	array traffic, not a hardware counter). The batch is the
+	calcZfactor_DAK_batch path ('newton', auto bracket) on the native thread
+	pool (threads = 1 is the calling thread), the points depend on seed and
+	size only, the runs are comparable.
+'''
+def benchmarkScaling(threads = None, sizes = (10**2, 10**3, 10**4, 10**5,
+                     10**6, 10**7, 10**8), repeat = 5, minPoints = 10**6,
+                     seed = 1, path = 'bench_output.txt', bytesPerPoint = 32,
+                     chunk = 4096):
+	if (threads is None):
+		nMax    = min(64, os.cpu_count() or 1)
+		threads = [1 << k for k in range(7) if ((1 << k) <= nMax)]
+	if (isinstance(threads, int)):
+		threads = [threads]
+	if (isinstance(sizes, int)):
+		sizes = [sizes]
+	machine = benchMachine()
+
+	records = []
+	for n in sizes:
+		rng = np.random.default_rng(seed)
+		Ppr = rng.uniform(0.2, 30.0, n)
+		Tpr = rng.uniform(1.0, 3.0, n)
+		nPass = -(-minPoints // n)
+		base  = None
+
+		for nThreads in threads:
+			# The first call (re)starts the pool
+			calcZfactor_DAK_batch(Ppr, Tpr, threads = nThreads, chunk = chunk)
+			times = np.empty(repeat)
+			for k in range(repeat):
+				startTime = time.perf_counter()
+				for i in range(nPass):
+					calcZfactor_DAK_batch(Ppr, Tpr, threads = nThreads,
+					                      chunk = chunk)
+				times[k] = time.perf_counter() - startTime
+
+			rate = n * nPass / float(np.median(times))
+			if (base is None):
+				base = rate / nThreads
+			record = {'benchmark': 'scaling', 'threads': nThreads,
+			          'points': n, 'chunk': chunk, 'passes': nPass,
+			          'repeat': repeat,
+			          'seed': seed, 'median': float(np.median(times)),
+			          'min': float(times.min()), 'max': float(times.max()),
+			          'pointsPerSecond': rate,
+			          'efficiency': rate / (nThreads * base),
+			          'bandwidth': rate * bytesPerPoint}
+			record.update(machine)
+			records.append(record)
+
+			print('{:3d} threads {:10d} points  {:12.0f} points/s  '
+			      'efficiency {:.2f}  {:.3f} GB/s'.format(nThreads, n, rate,
+			      record['efficiency'], record['bandwidth'] * 1e-9))
+
+	writeBenchRecords(records, path)
+	return records
+
+
+'''
+	Engines of benchmarkPareto(), exact solvers first.
+'''
+PARETO_ENGINES = ('bisection', 'brent', 'batch bisection', 'batch newton',
+                  'newton 3', 'newton 2', 'newton 1', 'estimateZ_DAK', 'papay',
+                  'table 40x21', 'table 150x101', 'table adaptive',
+                  'chebyshev', 'compiled')
+
+
+'''
+	name     - one of PARETO_ENGINES;
+	Ppr, Tpr - points of the benchmark (1d arrays).
+	return: call, mask - the evaluation (Ppr, Tpr) -> z of the engine and the
+	points it covers (None for all), None if the engine is not available. The
+	tables are built here (not timed), coarse on purpose (the cheap end of the
+	front) except 'table 150x101', the buildZTable_DAK defaults. 'bisection'
+	and 'brent' are calcZfactor_DAK point by point.
+'''
+def benchEngine(name, Ppr, Tpr):
+	if (name == 'bisection' or name == 'brent'):
+		def call(Ppr, Tpr):
+			return np.array([calcZfactor_DAK(p, t, method = name)
+			                 for p, t in zip(Ppr.tolist(), Tpr.tolist())])
+		return(call, None)
+	elif (name == 'batch bisection'):
+		return(lambda Ppr, Tpr: calcZfactor_DAK_batch(Ppr, Tpr,
+		                                              method = 'bisection'), None)
+	elif (name == 'batch newton'):
+		return(calcZfactor_DAK_batch, None)
+	elif (name.startswith('newton ')):
+		nIter = int(name.split()[1])
+		return(lambda Ppr, Tpr: calcZfactor_DAK_iter(Ppr, Tpr, nIter), None)
+	elif (name == 'estimateZ_DAK'):
+		return(estimateZ_DAK, None)
+	elif (name == 'papay'):
+		return(calcZfactor_Papay, None)
+	elif (name == 'table 40x21' or name == 'table 150x101'):
+		nPpr, nTpr = [int(n) for n in name.split()[1].split('x')]
+		table = buildZTable_DAK(nPpr = nPpr, nTpr = nTpr)
+		return(lambda Ppr, Tpr: calcZfactor_table(table, Ppr, Tpr), None)
+	elif (name == 'table adaptive'):
+		table = buildZTableAdaptive_DAK(tolerance = 1.0e-4)
+		return(lambda Ppr, Tpr: calcZfactor_tableAdaptive(table, Ppr, Tpr),
+		       None)
+	elif (name == 'chebyshev'):
+		table = buildZChebyshev_DAK(nPpr = 8, nTpr = 8, degP = 5, degT = 5)
+		return(lambda Ppr, Tpr: calcZfactor_Chebyshev(table, Ppr, Tpr), None)
+	elif (name == 'compiled'):
+		if (zfactorCore is None):
+			return None
+		sg, (PMin, PMax), (TMin, TMax), n = calcZfactorCompiledDomain()
+		# 1 (psia) = 1*6894.757293168/101325 (atm), 1 (K) = 1-273.15 (°C).
+		Ppc = calcPpc(sg) * 6894.757293168 / 101325
+		Tpc = calcTpc(sg)
+		P   = Ppr * Ppc
+		T   = Tpr * Tpc - 273.15
+		mask = (PMin <= P) & (P <= PMax) & (TMin <= T) & (T <= TMax)
+		return(lambda Ppr, Tpr: calcZfactor_compiled(Ppr * Ppc,
+		                                             Tpr * Tpc - 273.15), mask)
+	raise ValueError('benchEngine(). Unknown engine: ' + str(name))
+
+
+'''
+	Ppr, Tpr - pseudo reduced pressure and temperature (arrays).
+	return: z - DAK root to machine precision: calcZfactor_DAK_batch polished
+	by three Newton steps (dF/dz of calcResidualDer_DAK).
+'''
+def calcZfactorReference_DAK(Ppr, Tpr):
+	z = calcZfactor_DAK_batch(Ppr, Tpr)
+	C1, C2, C3, C4, C5 = calcCoeffs_DAK(Ppr, Tpr)
+	for i in range(3):
+		z = z - (calcResidual_DAK_batch(z, C1, C2, C3, C4, C5) /
+		         calcResidualDer_DAK(z, Ppr, Tpr)[0])
+	return z
+
+
+'''
+	engines        - names of PARETO_ENGINES;
+	nPpr, nTpr     - reference grid nodes (the counts are not aligned with the
+	                 table nodes);
+	PprMin, PprMax - Ppr range of the grid;
+	TprMin, TprMax - Tpr range of the grid, 1 <= Tpr < 1.05 is left out by
+	                 default: the DAK has several roots there and the
+	                 engines disagree on the root, not on the accuracy;
+	repeat         - timed runs per engine, a run repeats the grid for at
+	                 least minTime seconds;
+	minTime        - seconds;
+	path           - output file, one JSON line per engine is appended (None
+	                 to skip);
+	figure         - file of the cost vs error plot (None: no plot, 'show':
+	                 plt.show()).
+	return: list of the records: cost per point (ns, median run), max and RMS
+	|z - z_ref| against calcZfactorReference_DAK, max relative error and
+	'pareto' - no cheaper engine is as accurate (max error).
+'''
+def benchmarkPareto(engines = PARETO_ENGINES, nPpr = 157, nTpr = 97,
+                    PprMin = 0.2, PprMax = 30.0, TprMin = 1.05, TprMax = 3.0,
+                    repeat = 5, minTime = 0.05, path = 'bench_output.txt',
+                    figure = None):
+	if (isinstance(engines, str)):
+		engines = (engines,)
+	Ppr, Tpr = np.meshgrid(np.linspace(PprMin, PprMax, nPpr),
+	                       np.linspace(TprMin, TprMax, nTpr))
+	Ppr  = Ppr.ravel()
+	Tpr  = Tpr.ravel()
+	zRef = calcZfactorReference_DAK(Ppr, Tpr)
+	machine = benchMachine()
+
+	records = []
+	for name in engines:
+		engine = benchEngine(name, Ppr, Tpr)
+		if (engine is None):
+			continue
+		call, mask = engine
+		P = Ppr if (mask is None) else Ppr[mask]
+		T = Tpr if (mask is None) else Tpr[mask]
+		r = zRef if (mask is None) else zRef[mask]
+
+		startTime = time.perf_counter()
+		z = np.asarray(call(P, T))
+		nPass = max(1, int(minTime / (time.perf_counter() - startTime)))
+		times = np.empty(repeat)
+		for k in range(repeat):
+			startTime = time.perf_counter()
+			for i in range(nPass):
+				call(P, T)
+			times[k] = (time.perf_counter() - startTime) / nPass
+
+		err    = np.abs(z - r)
+		record = {'benchmark': 'pareto', 'engine': name, 'points': P.size,
+		          'nPpr': nPpr, 'nTpr': nTpr, 'Ppr': [PprMin, PprMax],
+		          'Tpr': [TprMin, TprMax], 'repeat': repeat,
+		          'passes': nPass,
+		          'nsPerPoint': float(np.median(times)) / P.size * 1e9,
+		          'maxError': float(err.max()),
+		          'rmsError': float(np.sqrt(np.mean(err*err))),
+		          'maxRelError': float((err / r).max())}
+		record.update(machine)
+		records.append(record)
+
+	best = np.inf
+	for record in sorted(records, key = lambda record: record['nsPerPoint']):
+		record['pareto'] = record['maxError'] < best
+		best = min(best, record['maxError'])
+
+	for record in records:
+		print('{:16s} {:10.1f} ns/point  max {:.2e}  rms {:.2e}{}'.format(
+		      record['engine'], record['nsPerPoint'], record['maxError'],
+		      record['rmsError'], '  *' if (record['pareto']) else ''))
+
+	writeBenchRecords(records, path)
+
+	if (figure is not None):
+		fig  = plt.figure()
+		axes = fig.add_axes([0.12, 0.1, 0.8, 0.8])
+		cost = [record['nsPerPoint'] for record in records]
+		axes.loglog(cost, [record['maxError'] for record in records], 'o',
+		            label = 'max error')
+		axes.loglog(cost, [record['rmsError'] for record in records], 'x',
+		            label = 'RMS error')
+		front = sorted((record['nsPerPoint'], record['maxError'])
+		               for record in records if (record['pareto']))
+		axes.step([c for c, e in front], [e for c, e in front], where = 'post',
+		          label = 'Pareto front')
+		for record in records:
+			axes.annotate(record['engine'], (record['nsPerPoint'],
+			              record['maxError']), fontsize = 8)
+		axes.legend(loc = 'upper right', fontsize = 10)
+		axes.set_xlabel('Cost, ns per point')
+		axes.set_ylabel('|z - z_DAK|')
+		plt.grid()
+		if (figure == 'show'):
+			plt.show()
+		else:
+			fig.savefig(figure)
+	return records
+
+
+'''
+	args - 'name=value' arguments of the benchmark, values are JSON (null for
+	None, a plain string is taken as is).
+	return: keyword arguments of benchmark(), benchmarkScaling(),
+	benchmarkPareto().
+'''
+def parseBenchArgs(args):
+	kwargs = {}
+	for arg in args:
+		name, value = arg.split('=', 1)
+		try:
+			kwargs[name] = json.loads(value)
+		except ValueError:
+			kwargs[name] = value
+	return kwargs
+
+
 '''
 	TEST 1: solve (Applied Petroleum Reservoir Engineering. B.C. Craft, M.F. Hawkins)
 '''
@@ -221,11 +2892,7 @@ def test2():
 	Ppr = calcPpr(P, sg)
 	Tpr = calcTpr(T, sg)
 
-	z = np.zeros((M, N))
-	for i in range(M):
-		tmp = Tpr[i]
-		for j in range(N):
-			z[i, j] = calcZfactor_DAK(Ppr[j], tmp, 2.5e-4, 6)
+	z = calcZfactor_DAK_sweep(Ppr[np.newaxis, :], Tpr[:, np.newaxis])
 
 	fig  = plt.figure()
 	axes = fig.add_axes([0.1, 0.1, 0.8, 0.8])
@@ -278,39 +2945,33 @@ def test3():
 	startTime = 0
 
 	if (dependence == 1):
-		startTime = time.time()
+		startTime = time.perf_counter()
 
 		P     = np.linspace(0, 500, N)
 		T     = np.linspace(-30, 200, M)
 		x     = calcPpr(P, sg)
 		const = calcTpr(T, sg)
 
-		for i in range(M):
-			tmp = const[i]
-			for j in range(N):
-				y[i, j] = calcZfactor_DAK(x[j], tmp, za, zb)
+		y = calcZfactor_DAK_sweep(x[np.newaxis, :], const[:, np.newaxis])
 
 		str_xyc = ['Pseudo reduced pressure', 'Compressibility factor Z', 'Tpr',
 		            'lower right']
 
 	elif (dependence == 2):
-		startTime = time.time()
+		startTime = time.perf_counter()
 
 		P     = np.linspace(1, 500, M)
 		T     = np.linspace(-30, 200, N)
 		const = calcPpr(P, sg)
 		x     = calcTpr(T, sg)
 
-		for i in range(M):
-			tmp = const[i]
-			for j in range(N):
-				y[i, j] = calcZfactor_DAK(tmp, x[j], za, zb)
+		y = calcZfactor_DAK_sweep(const[:, np.newaxis], x[np.newaxis, :])
 
 		str_xyc = ['Pseudo reduced temperature', 'Compressibility factor Z', 'Ppr',
 		            'lower right']
 
 	elif (dependence == 3):
-		startTime = time.time()
+		startTime = time.perf_counter()
 
 		P     = np.linspace(1, 500, M)
 		T     = np.linspace(-30, 200, N)
@@ -320,13 +2981,13 @@ def test3():
 		for i in range(M):
 			tmp = const[i]
 			for j in range(N):
-				y[i, j] = calc_dZdTpr(tmp, x[j], -zb, -za, za, zb)
+				y[i, j] = calc_dZdTpr(tmp, x[j], -zb, -za)
 
 		str_xyc = ['Pseudo reduced temperature', 'dZ/dTpr', 'Ppr',
 		            'lower right']
 
 	elif (dependence == 4):
-		startTime = time.time()
+		startTime = time.perf_counter()
 
 		P     = np.linspace(1, 500, M)
 		T     = np.linspace(-30, 200, N)
@@ -336,11 +2997,14 @@ def test3():
 		for i in range(M):
 			tmp = const[i]
 			for j in range(N):
-				y[i, j] = calc_dZdPpr(tmp, x[j], za, zb, za, zb)
+				y[i, j] = calc_dZdPpr(tmp, x[j], za, zb)
 
 		str_xyc = ['Pseudo reduced temperature', 'dZ/dPpr', 'Ppr',
 		            'upper right']
 
+	endTime = time.perf_counter()
+	print('Прошло времени: {:.3f} с'.format(endTime - startTime))
+
 	clrs20 = ('#689f38','#009688','#b2dfdb','#e64a19','#00bcd4','#212121',
 	          '#757575','#BDBDBD','#fbc02d','#ffeb3b','#0288d1','#03a9f4',
 	          '#b3e5fc','#536dfe','#757575','#9C8BBF','#969CE7','#448aff',
@@ -360,11 +3024,14 @@ def test3():
 	axes.set_ylabel(str_xyc[1])
 	axes.set_xlabel(str_xyc[0])
 	plt.grid()
-
-	endTime = time.time()
-	print('Прошло времени: {:.3f} с'.format(endTime - startTime))
-
 	plt.show()
 
 
-test3()
\ No newline at end of file
+if (len(sys.argv) > 1 and sys.argv[1] == 'bench'):
+	benchmark(**parseBenchArgs(sys.argv[2:]))
+elif (len(sys.argv) > 1 and sys.argv[1] == 'scaling'):
+	benchmarkScaling(**parseBenchArgs(sys.argv[2:]))
+elif (len(sys.argv) > 1 and sys.argv[1] == 'pareto'):
+	benchmarkPareto(**parseBenchArgs(sys.argv[2:]))
+else:
+	test3()
\ No newline at end of file
@@ -0,0 +1,653 @@
+/*
+	Native compute core of z-factor.py: the Dranchuk-Abbou Kassem residual and
+	the safeguarded Newton root solve evaluated on W lanes at a time.
+
+	The kernel (zfactor_kernel.h) is compiled for scalar, AVX2 and AVX-512
+	targets, the widest one supported by the CPU is picked when the library is
+	loaded. ZFACTOR_ISA=scalar|avx2|avx512 overrides the choice (benchmarks).
+
+	zfactor_ct_eval() interpolates a table baked in at compile time
+	(zfactor_table_ct.h), the gas and the grid are set by the ZF_CT_* macros.
+
+	zfactor_dak_newton_parallel() runs the solve on a persistent thread pool
+	(zfactor_pool_init), the workers are kept between the calls.
+
+	Build (next to z-factor.py, it is picked up automatically):
+		g++ -O3 -shared -fPIC -pthread -o libzfactor.so zfactor_core.cpp
+*/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+#include "zfactor_table_ct.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ZF_X86 1
+#endif
+
+// Compile-time table: P in atm, T in °C (the test3 ranges by default)
+#ifndef ZF_CT_SG
+#define ZF_CT_SG    0.661
+#endif
+#ifndef ZF_CT_P_MIN
+#define ZF_CT_P_MIN 1.0
+#endif
+#ifndef ZF_CT_P_MAX
+#define ZF_CT_P_MAX 500.0
+#endif
+#ifndef ZF_CT_T_MIN
+#define ZF_CT_T_MIN -30.0
+#endif
+#ifndef ZF_CT_T_MAX
+#define ZF_CT_T_MAX 200.0
+#endif
+#ifndef ZF_CT_NP
+#define ZF_CT_NP    64
+#endif
+#ifndef ZF_CT_NT
+#define ZF_CT_NT    32
+#endif
+
+namespace scalar {
+#define ZF_W 1
+#include "zfactor_kernel.h"
+#undef ZF_W
+}
+
+#ifdef ZF_X86
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace avx2 {
+#define ZF_W 4
+#include "zfactor_kernel.h"
+#undef ZF_W
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq,avx2,fma")
+namespace avx512 {
+#define ZF_W 8
+#include "zfactor_kernel.h"
+#undef ZF_W
+}
+#pragma GCC pop_options
+#endif
+
+
+typedef int64_t (*SolveFn)(int64_t, const double *, const double *,
+                           const double *, const double *, double *, int64_t *,
+                           int8_t *, double *);
+typedef int64_t (*SweepFn)(int64_t, int64_t, const double *, const double *,
+                           int, double *, int64_t *, int8_t *, double *);
+typedef int64_t (*GridFn)(int64_t, int64_t, const double *, const double *,
+                          const double *, double, double, int, double *,
+                          int64_t *, int8_t *, double *);
+
+struct Impl
+{
+	const char *name;
+	SolveFn     solve;
+	SweepFn     sweep;
+	GridFn      grid;
+	bool        supported;
+};
+
+
+/*
+	return: implementation used by zfactor_dak_newton(), the widest supported
+	one unless ZFACTOR_ISA names another supported implementation.
+*/
+static const Impl *selectImpl()
+{
+	static Impl impls[] = {
+#ifdef ZF_X86
+		{ "avx512", avx512::solveBlocks, avx512::sweepBlocks,
+		  avx512::gridBlocks, false },
+		{ "avx2",   avx2::solveBlocks,   avx2::sweepBlocks,
+		  avx2::gridBlocks,   false },
+#endif
+		{ "scalar", scalar::solveBlocks, scalar::sweepBlocks,
+		  scalar::gridBlocks, true  },
+	};
+	const int count = sizeof(impls) / sizeof(impls[0]);
+
+#ifdef ZF_X86
+	__builtin_cpu_init();
+	impls[0].supported = __builtin_cpu_supports("avx512f") &&
+	                     __builtin_cpu_supports("avx512dq");
+	impls[1].supported = __builtin_cpu_supports("avx2") &&
+	                     __builtin_cpu_supports("fma");
+#endif
+
+	const char *isa = std::getenv("ZFACTOR_ISA");
+	if (isa != NULL)
+		for (int k = 0; k < count; ++k)
+			if (impls[k].supported && std::strcmp(isa, impls[k].name) == 0)
+				return &impls[k];
+
+	for (int k = 0; k < count; ++k)
+		if (impls[k].supported)
+			return &impls[k];
+	return &impls[count - 1];
+}
+
+static const Impl *impl = selectImpl();
+
+
+/*
+	Chunks [next, end) of one worker. The owner and the thieves take chunks
+	from the same end with fetch_add, a chunk is solved exactly once.
+*/
+struct alignas(64) ChunkRange
+{
+	std::atomic<int64_t> next;
+	int64_t              end;
+};
+
+/*
+	The points of a zfactor_dak_newton_parallel() call, za == NULL for the
+	per point bracket.
+*/
+struct Job
+{
+	int64_t       n;
+	int64_t       chunk;
+	const double *Ppr;
+	const double *Tpr;
+	const double *za;
+	const double *zb;
+	double       *z;
+	int64_t      *nIter;
+	int8_t       *atLimit;
+	double       *residual;
+};
+
+/*
+	Persistent pool: size - 1 workers wait for the next generation, the
+	calling thread is worker 0. Worker k starts on the k-th contiguous run of
+	chunks and then steals from the runs of the others, so the chunks that
+	converge slowly (near Tpr ~ 1) are shared out instead of stalling a
+	static partition.
+*/
+struct Pool
+{
+	int                           size = 1;
+	std::vector<std::thread>      workers;
+	std::unique_ptr<ChunkRange[]> ranges;
+	std::mutex                    mutex;
+	std::condition_variable       start;
+	std::condition_variable       done;
+	int64_t                       generation = 0;
+	int                           running    = 0;
+	bool                          stop       = false;
+	Job                           job        = {};
+	std::atomic<int64_t>          left{0};
+};
+
+// Never destroyed: a forked child abandons the pool of the parent (forkChild)
+static Pool      *pool = new Pool;
+static std::mutex poolCall;   // one parallel call (or restart) at a time
+
+/*
+	k - worker index.
+	Solves the chunks of the own run, then of the others.
+*/
+static void runChunks(int k)
+{
+	const Job &job  = pool->job;
+	int64_t    left = 0;
+
+	for (int v = 0; v < pool->size; ++v)
+	{
+		ChunkRange &range = pool->ranges[(k + v) % pool->size];
+		for (;;)
+		{
+			int64_t c = range.next.fetch_add(1, std::memory_order_relaxed);
+			if (c >= range.end)
+				break;
+
+			int64_t i = c * job.chunk;
+			int64_t m = job.n - i < job.chunk ? job.n - i : job.chunk;
+			left += impl->solve(m, job.Ppr + i, job.Tpr + i,
+			                    job.za != NULL ? job.za + i : NULL,
+			                    job.zb != NULL ? job.zb + i : NULL,
+			                    job.z + i, job.nIter + i, job.atLimit + i,
+			                    job.residual != NULL ? job.residual + i : NULL);
+		}
+	}
+
+	pool->left.fetch_add(left, std::memory_order_relaxed);
+}
+
+/*
+	k    - worker index;
+	seen - generation at the start (the worker waits for the next one).
+*/
+static void workerLoop(int k, int64_t seen)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			pool->start.wait(lock, [&] {
+				return pool->stop || pool->generation != seen;
+			});
+			if (pool->stop)
+				return;
+			seen = pool->generation;
+		}
+
+		runChunks(k);
+
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (--pool->running == 0)
+			pool->done.notify_one();
+	}
+}
+
+static void stopPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->stop = true;
+	}
+	pool->start.notify_all();
+	for (std::thread &worker : pool->workers)
+		worker.join();
+	pool->workers.clear();
+	pool->stop = false;
+	pool->size = 1;
+}
+
+/*
+	fork() copies the pool but not its workers: the parent holds poolCall
+	across the fork (no job in flight), the child drops the pool without
+	joining (its locks may be held by the missing workers) and starts a new one
+	on the next call.
+*/
+static void forkPrepare()
+{
+	poolCall.lock();
+}
+
+static void forkParent()
+{
+	poolCall.unlock();
+}
+
+static void forkChild()
+{
+	pool = new Pool;
+	poolCall.unlock();
+}
+
+/*
+	size - number of threads, <= 0 for one per core.
+*/
+static void startPool(int size)
+{
+	if (size <= 0)
+		size = (int)std::thread::hardware_concurrency();
+	if (size <= 0)
+		size = 1;
+
+	static const int forkHandlers = pthread_atfork(forkPrepare, forkParent,
+	                                               forkChild);
+	(void)forkHandlers;
+
+	stopPool();
+	pool->size   = size;
+	pool->ranges.reset(new ChunkRange[size]);
+	for (int k = 1; k < size; ++k)
+		pool->workers.emplace_back(workerLoop, k, pool->generation);
+}
+
+static constexpr zfct::Table<ZF_CT_NP, ZF_CT_NT> ctTable =
+	zfct::makeTable<ZF_CT_NP, ZF_CT_NT>(ZF_CT_P_MIN, ZF_CT_P_MAX, ZF_CT_T_MIN,
+	                                    ZF_CT_T_MAX, ZF_CT_SG);
+
+
+extern "C" {
+
+/*
+	n        - number of points;
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	za, zb   - z locate [za, zb] per point;
+	z        - out: gas compressibility factor based on DAK EoS;
+	nIter    - out: residual evaluations per point;
+	atLimit  - out: 1 for the points whose solve hit the iteration limit (the
+	           bracket evaluations in nIter do not count);
+	residual - out: the last residual of the solve per point, NULL to skip it
+	           (the solver statistics of z-factor.py).
+	return: number of points that hit the iteration limit.
+*/
+int64_t zfactor_dak_newton(int64_t n, const double *Ppr, const double *Tpr,
+                           const double *za, const double *zb,
+                           double *z, int64_t *nIter, int8_t *atLimit,
+                           double *residual)
+{
+	return impl->solve(n, Ppr, Tpr, za, zb, z, nIter, atLimit, residual);
+}
+
+/*
+	zfactor_dak_newton() with the bracket of calcBracket_DAK_batch of
+	z-factor.py taken per point (nIter includes its residual evaluations).
+*/
+int64_t zfactor_dak_newton_auto(int64_t n, const double *Ppr,
+                                const double *Tpr, double *z, int64_t *nIter,
+                                int8_t *atLimit, double *residual)
+{
+	return impl->solve(n, Ppr, Tpr, NULL, NULL, z, nIter, atLimit, residual);
+}
+
+/*
+	Ppr, Tpr - pseudo reduced pressure and temperature of one point;
+	za, zb   - z locate [za, zb], unless bracket;
+	bracket  - take the bracket of calcBracket_DAK_batch of z-factor.py;
+	nIter, atLimit, residual - out: as zfactor_dak_newton() for the point.
+	return: gas compressibility factor, zfactor_dak_newton() of one point
+	taken by value (calcZfactor_DAK of z-factor.py with method = 'newton',
+	without the array arguments of the batch calls).
+*/
+double zfactor_dak_newton_point(double Ppr, double Tpr, double za, double zb,
+                                int bracket, int64_t *nIter, int8_t *atLimit,
+                                double *residual)
+{
+	double z;
+	impl->solve(1, &Ppr, &Tpr, bracket ? NULL : &za, bracket ? NULL : &zb, &z,
+	            nIter, atLimit, residual);
+	return z;
+}
+
+/*
+	nThreads - threads of the pool, <= 0 for one per core.
+	return: size of the pool. The workers are started here (or on the first
+	zfactor_dak_newton_parallel() call) and kept until the next restart.
+*/
+int zfactor_pool_init(int nThreads)
+{
+	std::lock_guard<std::mutex> call(poolCall);
+	startPool(nThreads);
+	return pool->size;
+}
+
+/*
+	return: size of the pool, 0 if it is not started.
+*/
+int zfactor_pool_size()
+{
+	std::lock_guard<std::mutex> call(poolCall);
+	return pool->ranges ? pool->size : 0;
+}
+
+/*
+	zfactor_dak_newton() on the pool (za == NULL: zfactor_dak_newton_auto()),
+	chunk - points per chunk (a multiple of the vector width is best). The
+	results do not depend on the number of threads.
+*/
+int64_t zfactor_dak_newton_parallel(int64_t n, const double *Ppr,
+                                    const double *Tpr, const double *za,
+                                    const double *zb, double *z,
+                                    int64_t *nIter, int8_t *atLimit,
+                                    double *residual, int64_t chunk)
+{
+	std::lock_guard<std::mutex> call(poolCall);
+	if (!pool->ranges)
+		startPool(0);
+	if (chunk < 1)
+		chunk = 1;
+	if (pool->size == 1 || n <= chunk)
+		return impl->solve(n, Ppr, Tpr, za, zb, z, nIter, atLimit, residual);
+
+	const int64_t nChunks = (n + chunk - 1) / chunk;
+	for (int k = 0; k < pool->size; ++k)
+	{
+		pool->ranges[k].next.store(nChunks * k / pool->size,
+		                          std::memory_order_relaxed);
+		pool->ranges[k].end = nChunks * (k + 1) / pool->size;
+	}
+	pool->job = {n, chunk, Ppr, Tpr, za, zb, z, nIter, atLimit, residual};
+	pool->left.store(0, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->running = pool->size - 1;
+		++pool->generation;
+	}
+	pool->start.notify_all();
+
+	runChunks(0);
+
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	pool->done.wait(lock, [] { return pool->running == 0; });
+	return pool->left.load(std::memory_order_relaxed);
+}
+
+/*
+	The same with the bracket of calcBracket_DAK_batch per point.
+*/
+int64_t zfactor_dak_newton_auto_parallel(int64_t n, const double *Ppr,
+                                         const double *Tpr, double *z,
+                                         int64_t *nIter, int8_t *atLimit,
+                                         double *residual, int64_t chunk)
+{
+	return zfactor_dak_newton_parallel(n, Ppr, Tpr, NULL, NULL, z, nIter,
+	                                   atLimit, residual, chunk);
+}
+
+/*
+	nPoints, nCurves - points per curve and number of curves;
+	Ppr, Tpr         - pseudo reduced pressure and temperature, nPoints x
+	                   nCurves row major (the points of a curve are a column);
+	extrapolate      - predict z linearly from the previous two points;
+	z                - out: gas compressibility factor based on DAK EoS;
+	nIter            - out: residual evaluations per point;
+	atLimit          - out: 1 for the points that hit the iteration limit;
+	residual         - out: the last residual per point, NULL to skip it.
+	return: number of points that hit the iteration limit.
+	Continuation along the curves (calcZfactor_DAK_sweep of z-factor.py).
+*/
+int64_t zfactor_dak_sweep(int64_t nPoints, int64_t nCurves, const double *Ppr,
+                          const double *Tpr, int extrapolate, double *z,
+                          int64_t *nIter, int8_t *atLimit, double *residual)
+{
+	return impl->sweep(nPoints, nCurves, Ppr, Tpr, extrapolate, z, nIter,
+	                   atLimit, residual);
+}
+
+/*
+	nP, nT   - number of Ppr columns and Tpr rows;
+	Ppr, Tpr - pseudo reduced pressure (nP) and temperature (nT);
+	D        - Tpr factors D1..D5 of the rows, 5 x nT row major
+	           (calcCoeffFactors_DAK of z-factor.py);
+	za, zb   - z locate [za, zb] of all the points, unless bracket;
+	bracket  - take the bracket of calcBracket_DAK_batch per point;
+	z        - out: gas compressibility factor, nT x nP row major;
+	nIter    - out: residual evaluations per point;
+	atLimit  - out: 1 for the points that hit the iteration limit;
+	residual - out: the last residual per point, NULL to skip it.
+	return: number of points that hit the iteration limit.
+	Cartesian grid with separable coefficients (calcZfactor_DAK_grid of
+	z-factor.py).
+*/
+int64_t zfactor_dak_grid(int64_t nP, int64_t nT, const double *Ppr,
+                         const double *Tpr, const double *D, double za,
+                         double zb, int bracket, double *z, int64_t *nIter,
+                         int8_t *atLimit, double *residual)
+{
+	return impl->grid(nP, nT, Ppr, Tpr, D, za, zb, bracket, z, nIter,
+	                  atLimit, residual);
+}
+
+/*
+	return: name of the selected implementation ("scalar", "avx2", "avx512").
+*/
+const char *zfactor_isa()
+{
+	return impl->name;
+}
+
+/*
+	n        - number of points;
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, coeffs - ZTable of z-factor.py
+	(coeffs is cells x 16, a cell is 2 cache lines);
+	z        - out: gas compressibility factor interpolated from the table.
+*/
+void zfactor_table_eval(int64_t n, const double *Ppr, const double *Tpr,
+                        double PprMin, double hPpr, int64_t nPpr,
+                        double TprMin, double hTpr, int64_t nTpr,
+                        const double *coeffs, double *z)
+{
+	const double invHP = 1.0 / hPpr;
+	const double invHT = 1.0 / hTpr;
+
+	for (int64_t m = 0; m < n; ++m)
+	{
+		double  x = (Ppr[m] - PprMin) * invHP;
+		double  y = (Tpr[m] - TprMin) * invHT;
+		int64_t i = (int64_t)x - (x < 0.0);
+		int64_t j = (int64_t)y - (y < 0.0);
+		i = i < 0 ? 0 : (i > nPpr - 2 ? nPpr - 2 : i);
+		j = j < 0 ? 0 : (j > nTpr - 2 ? nTpr - 2 : j);
+		double u = x - (double)i;
+		double v = y - (double)j;
+
+		const double *c  = coeffs + 16 * (j * (nPpr - 1) + i);
+		double        zi = 0.0;
+		for (int k = 3; k >= 0; --k)
+		{
+			const double *ck = c + 4 * k;
+			zi = zi * u + (((ck[3] * v + ck[2]) * v + ck[1]) * v + ck[0]);
+		}
+		z[m] = zi;
+	}
+}
+
+/*
+	n        - number of points;
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, child, coeffs - ZTableAdaptive of
+	z-factor.py (coeffs is leaves x 16, a leaf is 2 cache lines);
+	z        - out: gas compressibility factor interpolated from the table.
+*/
+void zfactor_quadtree_eval(int64_t n, const double *Ppr, const double *Tpr,
+                           double PprMin, double hPpr, int64_t nPpr,
+                           double TprMin, double hTpr, int64_t nTpr,
+                           const int32_t *child, const double *coeffs,
+                           double *z)
+{
+	const double invHP = 1.0 / hPpr;
+	const double invHT = 1.0 / hTpr;
+
+	for (int64_t m = 0; m < n; ++m)
+	{
+		double  x = (Ppr[m] - PprMin) * invHP;
+		double  y = (Tpr[m] - TprMin) * invHT;
+		int64_t i = (int64_t)x - (x < 0.0);
+		int64_t j = (int64_t)y - (y < 0.0);
+		i = i < 0 ? 0 : (i > nPpr - 1 ? nPpr - 1 : i);
+		j = j < 0 ? 0 : (j > nTpr - 1 ? nTpr - 1 : j);
+		double u = x - (double)i;
+		double v = y - (double)j;
+
+		int32_t c = child[j * nPpr + i];
+		while (c >= 0)
+		{
+			int qx = u >= 0.5;
+			int qy = v >= 0.5;
+			u = 2.0 * u - qx;
+			v = 2.0 * v - qy;
+			c = child[c + 2 * qy + qx];
+		}
+
+		const double *ck = coeffs + 16 * (int64_t)(-c - 1);
+		double        zi = 0.0;
+		for (int k = 3; k >= 0; --k)
+		{
+			const double *cr = ck + 4 * k;
+			zi = zi * u + (((cr[3] * v + cr[2]) * v + cr[1]) * v + cr[0]);
+		}
+		z[m] = zi;
+	}
+}
+
+/*
+	n        - number of points;
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	PprMin, hPpr, nPpr, TprMin, hTpr, nTpr, degP, degT, coeffs - ZChebyshev of
+	z-factor.py (coeffs is tiles x (degP + 1)*(degT + 1), a tile is
+	contiguous);
+	z        - out: gas compressibility factor of the surrogate.
+*/
+void zfactor_poly_eval(int64_t n, const double *Ppr, const double *Tpr,
+                       double PprMin, double hPpr, int64_t nPpr,
+                       double TprMin, double hTpr, int64_t nTpr,
+                       int degP, int degT, const double *coeffs, double *z)
+{
+	const int64_t ncoef = (int64_t)(degP + 1) * (degT + 1);
+	const double  invHP = 1.0 / hPpr;
+	const double  invHT = 1.0 / hTpr;
+
+	for (int64_t m = 0; m < n; ++m)
+	{
+		double  x = (Ppr[m] - PprMin) * invHP;
+		double  y = (Tpr[m] - TprMin) * invHT;
+		int64_t i = (int64_t)x - (x < 0.0);
+		int64_t j = (int64_t)y - (y < 0.0);
+		i = i < 0 ? 0 : (i > nPpr - 1 ? nPpr - 1 : i);
+		j = j < 0 ? 0 : (j > nTpr - 1 ? nTpr - 1 : j);
+		double s = 2.0 * (x - (double)i) - 1.0;
+		double t = 2.0 * (y - (double)j) - 1.0;
+
+		const double *c  = coeffs + (j * nPpr + i) * ncoef;
+		double        zi = 0.0;
+		for (int k = degP; k >= 0; --k)
+		{
+			const double *ck  = c + (degT + 1) * k;
+			double        row = ck[degT];
+			for (int l = degT - 1; l >= 0; --l)
+				row = row * t + ck[l];
+			zi = zi * s + row;
+		}
+		z[m] = zi;
+	}
+}
+
+/*
+	n    - number of points;
+	P    - pressure, atm;
+	T    - temperature, °C;
+	z    - out: gas compressibility factor from the compile-time table.
+*/
+void zfactor_ct_eval(int64_t n, const double *P, const double *T, double *z)
+{
+	for (int64_t m = 0; m < n; ++m)
+		z[m] = zfct::eval(ctTable, P[m], T[m]);
+}
+
+/*
+	domain - out: sg, P min, P max, T min, T max and the node counts along P
+	and T of the compile-time table.
+*/
+void zfactor_ct_domain(double *domain)
+{
+	domain[0] = ctTable.sg;
+	domain[1] = ctTable.PMin;
+	domain[2] = ctTable.PMin + ctTable.hP * (ZF_CT_NP - 1);
+	domain[3] = ctTable.TMin;
+	domain[4] = ctTable.TMin + ctTable.hT * (ZF_CT_NT - 1);
+	domain[5] = ZF_CT_NP;
+	domain[6] = ZF_CT_NT;
+}
+
+}
@@ -0,0 +1,431 @@
+/*
+	DAK kernel of zfactor_core.cpp for one instruction set. It is included once
+	per target inside its own namespace with ZF_W (lanes per vector) defined and
+	the matching '#pragma GCC target' in effect, so there is no include guard.
+*/
+
+static const int W = ZF_W;
+
+typedef double  vd __attribute__((vector_size(W * sizeof(double))));
+typedef int64_t vi __attribute__((vector_size(W * sizeof(int64_t))));
+
+
+/*
+	x - argument, x <= 0.
+	return: exp(x) on every lane, relative error ~1e-15.
+	Cody-Waite reduction x = n*ln2 + r, |r| <= ln2/2, Taylor polynomial for
+	exp(r) and 2^n assembled in the exponent bits.
+*/
+static inline vd vexp(vd x)
+{
+	const double log2e   = 1.4426950408889634;
+	const double ln2_hi  = 6.93145751953125e-1;
+	const double ln2_lo  = 1.42860682030941723212e-6;
+	const double shifter = 6755399441055744.0; // 1.5 * 2^52
+	const double xMin    = -708.0;
+
+	vd xc = x < xMin ? xMin : x;
+	vd nd = (xc * log2e + shifter) - shifter;
+	vd r  = xc - nd * ln2_hi - nd * ln2_lo;
+
+	vd p = r * (1.0 / 39916800.0) + 1.0 / 3628800.0;
+	p = p * r + 1.0 / 362880.0;
+	p = p * r + 1.0 / 40320.0;
+	p = p * r + 1.0 / 5040.0;
+	p = p * r + 1.0 / 720.0;
+	p = p * r + 1.0 / 120.0;
+	p = p * r + 1.0 / 24.0;
+	p = p * r + 1.0 / 6.0;
+	p = p * r + 0.5;
+	p = p * r + 1.0;
+	p = p * r + 1.0;
+
+	vi n   = __builtin_convertvector(nd, vi);
+	vd two = (vd)((n + 1023) << 52);
+
+	return x < xMin ? 0.0 : p * two;
+}
+
+
+/*
+	return: true if any lane of mask is set.
+*/
+static inline bool anyLane(vi mask)
+{
+	bool any = false;
+	for (int k = 0; k < W; ++k)
+		any |= (mask[k] != 0);
+	return any;
+}
+
+
+/*
+	z      - gas compressibility factor of W lanes;
+	C1..C5 - coefficients of the DAK residual.
+	return: F(z) (calcResidual_DAK).
+*/
+static inline vd residual(vd z, vd C1, vd C2, vd C3, vd C4, vd C5)
+{
+	vd invZ  = 1.0 / z;
+	vd invZ2 = invZ*invZ;
+	vd t     = C5 * invZ2;
+	return z - 1.0 - C1 * invZ - C2 * invZ2 + C3 * invZ2*invZ2*invZ -
+	       C4 * invZ2 * (1.0 + t) * vexp(-t);
+}
+
+
+/*
+	Ppr, Tpr - pseudo reduced pressure and temperature of W lanes;
+	C1..C5   - coefficients of the DAK residual;
+	za, zb   - out: z locate [za, zb];
+	nIter    - out: residual evaluations spent per lane.
+	Lane-wise calcBracket_DAK_batch of z-factor.py: estimateZ_DAK +-1 %,
+	widened 4 times on the side without the sign change until [0.05, 5]. NaN
+	Ppr or Tpr give a NaN bracket.
+*/
+static inline void bracketLanes(vd Ppr, vd Tpr, vd C1, vd C2, vd C3, vd C4,
+                                vd C5, vd &za, vd &zb, vi &nIter)
+{
+	const double zMin   = 0.05;
+	const double zMax   = 5.0;
+	const double margin = 0.01;
+
+	vd t  = 1.0 / Tpr;
+	vd ea = ((2.05274 * t - 4.52232) * t + 2.93638) * t - 0.509211;
+	vd eb = ((-0.00843685 * t + 0.150749) * t - 0.0743268) * t + 0.0120777;
+	vd ec = ((1.33943 * t - 2.23511) * t + 1.78781) * t - 0.350467;
+	vd ed = ((-0.036929 * t + 0.0781448) * t - 0.0442235) * t + 0.00820655;
+	vd z0 = (1.0 + Ppr * (ea + eb * Ppr)) / (1.0 + Ppr * (ec + ed * Ppr));
+	z0    = z0 < zMin ? zMin : z0; // NaN stays NaN
+	z0    = z0 > zMax ? zMax : z0;
+
+	const vi zero = {};
+	vd d  = margin * z0;
+	za    = z0 - d < zMin ? zMin : z0 - d;
+	zb    = z0 + d > zMax ? zMax : z0 + d;
+	vd fa = residual(za, C1, C2, C3, C4, C5);
+	vd fb = residual(zb, C1, C2, C3, C4, C5);
+	nIter = zero + 2;
+
+	// F(za) > 0: the root is below, widen downwards
+	vi lower = (fa > 0.0) & (za > zMin);
+	vi down  = lower;
+	while (anyLane(down))
+	{
+		zb = down ? za : zb;
+		d  = down ? d * 4.0 : d;
+		za = down ? (z0 - d < zMin ? zMin : z0 - d) : za;
+		down  &= za > zMin;
+		nIter -= down;
+		fa     = residual(za, C1, C2, C3, C4, C5);
+		down  &= fa > 0.0;
+	}
+
+	// F(zb) < 0: the root is above, widen upwards
+	vi up = ~lower & (fb < 0.0) & (zb < zMax);
+	while (anyLane(up))
+	{
+		za = up ? zb : za;
+		d  = up ? d * 4.0 : d;
+		zb = up ? (z0 + d > zMax ? zMax : z0 + d) : zb;
+		up    &= zb < zMax;
+		nIter -= up;
+		fb     = residual(zb, C1, C2, C3, C4, C5);
+		up    &= fb < 0.0;
+	}
+}
+
+
+/*
+	Ppr, Tpr - pseudo reduced pressure and temperature of W lanes;
+	C1..C5   - coefficients of the DAK residual;
+	za, zb   - z locate [za, zb] of W lanes;
+	bracket  - ignore za, zb and take the bracketLanes bracket;
+	z        - out: gas compressibility factor;
+	nIter    - out: residual evaluations per lane (bracket included);
+	failed   - out: lanes that hit the iteration limit;
+	fExit    - out: the last residual of the solve per lane.
+	A lane with a NaN residual (NaN Ppr, Tpr or bracket) stops with z = NaN,
+	as solveZ_DAK_batch of z-factor.py.
+*/
+static inline void solveCoeffLanes(vd Ppr, vd Tpr, vd C1, vd C2, vd C3,
+                                   vd C4, vd C5, vd za, vd zb, bool bracket,
+                                   vd &z, vi &nIter, vi &failed, vd &fExit)
+{
+	const int    maxIter = 100;
+	const double epsilon = 2.0e-6;
+
+	const vi zero = {};
+
+	vd a      = za;
+	vd b      = zb;
+	vi active = ~zero;
+	nIter     = zero;
+	fExit     = za * 0.0;
+	if (bracket)
+		bracketLanes(Ppr, Tpr, C1, C2, C3, C4, C5, a, b, nIter);
+	z = (a + b) * 0.5;
+
+	for (int i = 0; i < maxIter; ++i)
+	{
+		vd invZn  = 1.0 / z;
+		vd invZn2 = invZn*invZn;
+		vd invZn3 = invZn2*invZn;
+		vd t      = C5 * invZn2;
+		vd ex     = vexp(-t);
+		vd fz = z - 1.0 - C1 * invZn - C2 * invZn2 + C3 * invZn2*invZn3 -
+			    C4 * invZn2 * (1.0 + t) * ex;
+		vd dfz = 1.0 + C1 * invZn2 + 2.0 * C2 * invZn3 - 5.0 * C3 * invZn3*invZn3 +
+			     2.0 * C4 * invZn3 * (1.0 + t - t*t) * ex;
+		nIter -= active;
+		fExit  = active ? fz : fExit;
+
+		a = (active & (fz < 0.0)) ? z : a;
+		b = (active & (fz > 0.0)) ? z : b;
+
+		vd zNew = z - fz / dfz;
+		zNew = ((a < zNew) & (zNew < b)) ? zNew : (a + b) * 0.5;
+
+		vd dz   = zNew - z;
+		vd conv = dz < 0.0 ? -dz : dz;
+		conv    = (b - a) < conv ? (b - a) : conv;
+
+		vi nan  = fz != fz;
+		zNew    = nan ? fz : zNew;
+		vi done = (conv <= epsilon) | (fz == 0.0) | nan;
+		z       = (active & (fz != 0.0)) ? zNew : z;
+		active &= ~done;
+
+		if (!anyLane(active))
+			break;
+	}
+
+	failed = active;
+}
+
+
+/*
+	Ppr, Tpr - pseudo reduced pressure and temperature of W lanes;
+	za, zb   - z locate [za, zb] of W lanes;
+	bracket  - ignore za, zb and take the bracketLanes bracket;
+	z, nIter, failed, fExit - out: see solveCoeffLanes.
+*/
+static inline void solveLanes(vd Ppr, vd Tpr, vd za, vd zb, bool bracket,
+                              vd &z, vi &nIter, vi &failed, vd &fExit)
+{
+	// C1..C5 coefficients (calcCoeffs_DAK)
+	vd invTpr  = 1.0 / Tpr;
+	vd invTpr2 = invTpr*invTpr;
+	vd invTpr3 = invTpr2*invTpr;
+	vd Rr_z    = 0.27*Ppr * invTpr;
+	vd Rr_z2   = Rr_z*Rr_z;
+
+	vd C1  = (0.3265 - 1.07 * invTpr - 0.5339 * invTpr3 +
+		     0.01569 * invTpr2*invTpr2 - 0.05165 * invTpr2*invTpr3) * Rr_z;
+	vd tmp = -0.7361 * invTpr + 0.1844 * invTpr2;
+	vd C2  = (0.5475 + tmp) * Rr_z2;
+	vd C3  = 0.1056 * tmp * Rr_z2*Rr_z2*Rr_z;
+	vd C4  = 0.6134 * Rr_z2 * invTpr3;
+	vd C5  = 0.7210 * Rr_z2;
+
+	solveCoeffLanes(Ppr, Tpr, C1, C2, C3, C4, C5, za, zb, bracket,
+	                z, nIter, failed, fExit);
+}
+
+
+/*
+	The batch loop of zfactor_dak_newton() for W lanes per vector, za and zb
+	NULL take the bracketLanes bracket, residual NULL is not written.
+*/
+static int64_t solveBlocks(int64_t n, const double *Ppr, const double *Tpr,
+                           const double *za, const double *zb,
+                           double *z, int64_t *nIter, int8_t *atLimit,
+                           double *residual)
+{
+	int64_t left = 0;
+
+	// The last block pads the missing lanes with the last point
+	for (int64_t i = 0; i < n; i += W)
+	{
+		vd p, t, a = {}, b = {}, zi, fe;
+		vi it, failed;
+		for (int k = 0; k < W; ++k)
+		{
+			int64_t j = i + k < n ? i + k : n - 1;
+			p[k] = Ppr[j];
+			t[k] = Tpr[j];
+			if (za != NULL)
+			{
+				a[k] = za[j];
+				b[k] = zb[j];
+			}
+		}
+		solveLanes(p, t, a, b, za == NULL, zi, it, failed, fe);
+		for (int k = 0; k < W && i + k < n; ++k)
+		{
+			z[i + k]     = zi[k];
+			nIter[i + k]   = it[k];
+			atLimit[i + k] = (failed[k] != 0);
+			left          += (failed[k] != 0);
+			if (residual != NULL)
+				residual[i + k] = fe[k];
+		}
+	}
+
+	return left;
+}
+
+
+/*
+	The continuation loop of zfactor_dak_sweep() for W curves per vector:
+	every point starts from the prediction z0 of its curve with the safeguard
+	[0.05, 2 z0 - 0.05], lanes that end on it (or NaN, after a NaN point) are
+	solved again from the bracketLanes bracket (calcSweep_DAK of z-factor.py).
+	residual NULL is not written.
+*/
+static int64_t sweepBlocks(int64_t nPoints, int64_t nCurves, const double *Ppr,
+                           const double *Tpr, int extrapolate, double *z,
+                           int64_t *nIter, int8_t *atLimit, double *residual)
+{
+	const double zMin = 0.05;
+	const double eps  = 4.0e-6;
+	int64_t      left = 0;
+
+	// The last block pads the missing lanes with the last curve
+	for (int64_t c = 0; c < nCurves; c += W)
+	{
+		vd p0 = {}, t0 = {}, p1 = {}, t1 = {}, z0 = {}, z1 = {};
+		for (int64_t i = 0; i < nPoints; ++i)
+		{
+			vd p, t, zi, fe;
+			vi it, failed;
+			for (int k = 0; k < W; ++k)
+			{
+				int64_t j = i * nCurves + (c + k < nCurves ? c + k : nCurves - 1);
+				p[k] = Ppr[j];
+				t[k] = Tpr[j];
+			}
+
+			if (i == 0)
+				solveLanes(p, t, p, t, true, zi, it, failed, fe);
+			else
+			{
+				vd zp = z1;
+				if (extrapolate && i > 1)
+				{
+					// projection of this step on the previous one
+					vd dP = p1 - p0;
+					vd dT = t1 - t0;
+					vd h2 = dP*dP + dT*dT;
+					vd h  = ((p - p1) * dP + (t - t1) * dT) / (h2 > 0.0 ? h2 : 1.0);
+					zp   += (z1 - z0) * (h2 > 0.0 ? h : 0.0);
+				}
+				zp = zp > 2.0 * zMin ? zp : 2.0 * zMin;
+
+				vd a = zp * 0.0 + zMin;
+				vd b = 2.0 * zp - zMin;
+				solveLanes(p, t, a, b, false, zi, it, failed, fe);
+
+				vi lost = (zi - a <= eps) | (b - zi <= eps) | (zi != zi);
+				if (anyLane(lost))
+				{
+					vd zr, er;
+					vi ir, fr;
+					solveLanes(p, t, a, b, true, zr, ir, fr, er);
+					zi      = lost ? zr : zi;
+					it     += lost & ir;
+					failed  = lost ? fr : failed;
+					fe      = lost ? er : fe;
+				}
+			}
+
+			for (int k = 0; k < W && c + k < nCurves; ++k)
+			{
+				z[i * nCurves + c + k]     = zi[k];
+				nIter[i * nCurves + c + k]   = it[k];
+				atLimit[i * nCurves + c + k] = (failed[k] != 0);
+				left += (failed[k] != 0);
+				if (residual != NULL)
+					residual[i * nCurves + c + k] = fe[k];
+			}
+
+			p0 = p1;
+			t0 = t1;
+			z0 = z1;
+			p1 = p;
+			t1 = t;
+			z1 = zi;
+		}
+	}
+
+	return left;
+}
+
+
+/*
+	The grid loop of zfactor_dak_grid(): blocks of 512 columns, every row of
+	a block takes its Tpr factors D (5 x nT, computed by the caller) and the
+	Ppr, Ppr^2, Ppr^5 of the columns from the block (calcZfactor_DAK_grid of
+	z-factor.py), residual NULL is not written.
+*/
+static int64_t gridBlocks(int64_t nP, int64_t nT, const double *Ppr,
+                          const double *Tpr, const double *D, double za,
+                          double zb, int bracket, double *z, int64_t *nIter,
+                          int8_t *atLimit, double *residual)
+{
+	const int64_t block = 512;
+	int64_t       left  = 0;
+
+	double *P1 = (double *)std::malloc(3 * (nP > 0 ? nP : 1) * sizeof(double));
+	double *P2 = P1 + nP;
+	double *P5 = P2 + nP;
+	for (int64_t j = 0; j < nP; ++j)
+	{
+		P1[j] = Ppr[j];
+		P2[j] = Ppr[j] * Ppr[j];
+		P5[j] = P2[j] * P2[j] * Ppr[j];
+	}
+
+	for (int64_t j0 = 0; j0 < nP; j0 += block)
+	{
+		int64_t j1 = j0 + block < nP ? j0 + block : nP;
+		for (int64_t i = 0; i < nT; ++i)
+		{
+			const double D1 = D[i];
+			const double D2 = D[nT + i];
+			const double D3 = D[2 * nT + i];
+			const double D4 = D[3 * nT + i];
+			const double D5 = D[4 * nT + i];
+
+			// The last vector pads the missing lanes with the last column
+			for (int64_t j = j0; j < j1; j += W)
+			{
+				vd p1, p2, p5, zi, fe;
+				vi it, failed;
+				for (int k = 0; k < W; ++k)
+				{
+					int64_t m = j + k < j1 ? j + k : j1 - 1;
+					p1[k] = P1[m];
+					p2[k] = P2[m];
+					p5[k] = P5[m];
+				}
+				const vd zero = {};
+				solveCoeffLanes(p1, zero + Tpr[i], D1 * p1, D2 * p2, D3 * p5,
+				                D4 * p2, D5 * p2, zero + za, zero + zb,
+				                bracket != 0, zi, it, failed, fe);
+				for (int k = 0; k < W && j + k < j1; ++k)
+				{
+					z[i * nP + j + k]     = zi[k];
+					nIter[i * nP + j + k]   = it[k];
+					atLimit[i * nP + j + k] = (failed[k] != 0);
+					left += (failed[k] != 0);
+					if (residual != NULL)
+						residual[i * nP + j + k] = fe[k];
+				}
+			}
+		}
+	}
+
+	std::free(P1);
+	return left;
+}
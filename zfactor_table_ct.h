@@ -0,0 +1,296 @@
+/*
+	Compile-time z-factor table of zfactor_core.cpp: the Dranchuk-Abbou Kassem
+	root solve is evaluated by the compiler on a (P, T) grid for one gas, the
+	table is a static read-only object (no initialization, no heap). The header
+	has no dependencies and can be used on its own in embedded builds:
+
+		static constexpr auto table =
+			zfct::makeTable<64, 32>(1.0, 500.0, -30.0, 200.0, 0.661);
+		double z = zfct::eval(table, P, T);
+*/
+#ifndef ZFACTOR_TABLE_CT_H
+#define ZFACTOR_TABLE_CT_H
+
+namespace zfct {
+
+/*
+	x - argument, x <= 0.
+	return: exp(x), constexpr (std::exp is not).
+*/
+constexpr double cexp(double x)
+{
+	if (x < -700.0)
+		return 0.0;
+
+	// x = -n ln2 + r, 0 <= r < ln2
+	const double ln2 = 0.6931471805599453;
+	int    n = (int)(-x / ln2) + 1;
+	double r = x + n * ln2;
+	if (r >= ln2)
+	{
+		n -= 1;
+		r -= ln2;
+	}
+
+	double term = 1.0;
+	double sum  = 1.0;
+	for (int k = 1; k < 15; ++k)
+	{
+		term *= r / k;
+		sum  += term;
+	}
+
+	// 2^-n by squaring
+	double half = 0.5;
+	for (; n > 0; n >>= 1)
+	{
+		if (n & 1)
+			sum *= half;
+		half *= half;
+	}
+	return sum;
+}
+
+/*
+	sg  - specific gravity (0.57 < sg < 1.68).
+	return: Ppc - pseudocritical pressure, psia; Tpc - pseudocritical
+	temperature, K (calcPpc, calcTpc of z-factor.py).
+*/
+constexpr double calcPpc(double sg)
+{
+	return 756.8 - 131.0 * sg - 3.60 * sg * sg;
+}
+
+constexpr double calcTpc(double sg)
+{
+	return (169.2 + 349.5 * sg - 74.0 * sg * sg) * 5.0 / 9.0;
+}
+
+/*
+	Ppr, Tpr - pseudo reduced pressure and temperature.
+	return: z - gas compressibility factor based on Dranchuk-Abbou Kassem EoS,
+	safeguarded Newton from z = 1 on [0.05, 5] to 1e-12 (solveZ_DAK_Newton of
+	z-factor.py).
+*/
+constexpr double calcZfactor_DAK(double Ppr, double Tpr)
+{
+	double invTpr  = 1.0 / Tpr;
+	double invTpr2 = invTpr*invTpr;
+	double invTpr3 = invTpr2*invTpr;
+	double Rr_z    = 0.27*Ppr * invTpr;
+	double Rr_z2   = Rr_z*Rr_z;
+
+	double C1  = (0.3265 - 1.07 * invTpr - 0.5339 * invTpr3 +
+	              0.01569 * invTpr2*invTpr2 - 0.05165 * invTpr2*invTpr3) * Rr_z;
+	double tmp = -0.7361 * invTpr + 0.1844 * invTpr2;
+	double C2  = (0.5475 + tmp) * Rr_z2;
+	double C3  = 0.1056 * tmp * Rr_z2*Rr_z2*Rr_z;
+	double C4  = 0.6134 * Rr_z2 * invTpr3;
+	double C5  = 0.7210 * Rr_z2;
+
+	double a  = 0.05;
+	double b  = 5.0;
+	double zn = 1.0;
+
+	for (int i = 0; i < 200; ++i)
+	{
+		double invZn  = 1.0 / zn;
+		double invZn2 = invZn*invZn;
+		double invZn3 = invZn2*invZn;
+		double t      = C5 * invZn2;
+		double ex     = cexp(-t);
+		double fz  = zn - 1.0 - C1 * invZn - C2 * invZn2 + C3 * invZn2*invZn3 -
+		             C4 * invZn2 * (1.0 + t) * ex;
+		double dfz = 1.0 + C1 * invZn2 + 2.0 * C2 * invZn3 -
+		             5.0 * C3 * invZn3*invZn3 +
+		             2.0 * C4 * invZn3 * (1.0 + t - t*t) * ex;
+
+		if (fz > 0.0)
+			b = zn;
+		else if (fz < 0.0)
+			a = zn;
+		else
+			break;
+
+		double zNew = zn - fz / dfz;
+		if (!(a < zNew && zNew < b))
+			zNew = 0.5 * (a + b);
+
+		double dz = zNew - zn;
+		zn = zNew;
+		if ((dz < 0.0 ? -dz : dz) <= 1.0e-12 || b - a <= 1.0e-12)
+			break;
+	}
+	return zn;
+}
+
+/*
+	z        - root of the DAK residual at (Ppr, Tpr);
+	Ppr, Tpr - pseudo reduced pressure and temperature;
+	dZdPpr, dZdTpr - out: dZ/dPpr, dZ/dTpr (implicit function theorem, as
+	calcImplicitDer2_DAK of z-factor.py).
+*/
+constexpr void calcZfactorDer_DAK(double z, double Ppr, double Tpr,
+                                  double &dZdPpr, double &dZdTpr)
+{
+	const double c = 0.7210;
+	double t   = 1.0 / Tpr;
+	double t2  = t*t;
+	double t3  = t2*t;
+	double Rr  = 0.27*Ppr * t / z;
+	double Rr2 = Rr*Rr;
+	double Rr4 = Rr2*Rr2;
+
+	double A1  = 0.3265 - 1.07 * t - 0.5339 * t3 + 0.01569 * t2*t2 -
+	             0.05165 * t2*t3;
+	double A1t = -1.07 - 1.6017 * t2 + 0.06276 * t3 - 0.25825 * t2*t2;
+	double A2  = 0.5475 - 0.7361 * t + 0.1844 * t2;
+	double A2t = -0.7361 + 0.3688 * t;
+	double A3  = 0.1056 * (-0.7361 * t + 0.1844 * t2);
+	double A3t = 0.1056 * A2t;
+	double B   = 0.6134 * t3;
+	double Bt  = 1.8402 * t2;
+	double ex  = cexp(-c * Rr2);
+	double H   = (Rr2 + c * Rr4) * ex;
+	double Hr  = (2.0 * Rr + 2.0 * c * Rr2*Rr - 2.0 * c*c * Rr4*Rr) * ex;
+
+	double Gr = A1 + 2.0 * A2 * Rr - 5.0 * A3 * Rr4 + B * Hr;
+	double Gt = A1t * Rr + A2t * Rr2 - A3t * Rr4*Rr + Bt * H;
+
+	double Fz = 1.0 + Gr * Rr / z;
+	double Fp = -Gr * 0.27 * t / z;
+	double Ft = -Gr * 0.27 * Ppr / z - Gt;
+
+	dZdPpr = -Fp / Fz;
+	dZdTpr = Ft / Fz * t2;
+}
+
+/*
+	NP, NT - number of nodes along P and T;
+	PMin, hP, TMin, hT - first node and step, P in atm, T in °C;
+	sg     - specific gravity of the gas;
+	c      - bicubic Hermite coefficients of the cells, row major in T,
+	         a_kl at [4*k + l] for u^k v^l (calcBicubicCoeffs of z-factor.py).
+*/
+template <int NP, int NT>
+struct Table
+{
+	double PMin;
+	double hP;
+	double TMin;
+	double hT;
+	double sg;
+	double c[(NP - 1) * (NT - 1)][16];
+};
+
+/*
+	return: Table over [PMin, PMax] x [TMin, TMax] for the gas sg. The node
+	derivatives are analytic, the mixed one is the central difference of
+	dZ/dP along T (one sided on the edges).
+*/
+template <int NP, int NT>
+constexpr Table<NP, NT> makeTable(double PMin, double PMax, double TMin,
+                                  double TMax, double sg)
+{
+	Table<NP, NT> table{};
+	table.PMin = PMin;
+	table.hP   = (PMax - PMin) / (NP - 1);
+	table.TMin = TMin;
+	table.hT   = (TMax - TMin) / (NT - 1);
+	table.sg   = sg;
+
+	// 1 (atm) = 1*101325/6894.757293168 (psia), 1 (°C) = 1+273.15 (K).
+	const double Ppc = calcPpc(sg) * 6894.757293168 / 101325;
+	const double Tpc = calcTpc(sg);
+
+	// Values and derivatives in index units
+	double z[NT][NP]{};
+	double zP[NT][NP]{};
+	double zT[NT][NP]{};
+	for (int j = 0; j < NT; ++j)
+		for (int i = 0; i < NP; ++i)
+		{
+			double Ppr = (PMin + i * table.hP) / Ppc;
+			double Tpr = (TMin + j * table.hT + 273.15) / Tpc;
+			double dZdPpr = 0.0;
+			double dZdTpr = 0.0;
+			z[j][i] = calcZfactor_DAK(Ppr, Tpr);
+			calcZfactorDer_DAK(z[j][i], Ppr, Tpr, dZdPpr, dZdTpr);
+			zP[j][i] = dZdPpr * table.hP / Ppc;
+			zT[j][i] = dZdTpr * table.hT / Tpc;
+		}
+
+	double zPT[NT][NP]{};
+	for (int j = 0; j < NT; ++j)
+		for (int i = 0; i < NP; ++i)
+		{
+			int j0 = j > 0 ? j - 1 : 0;
+			int j1 = j < NT - 1 ? j + 1 : NT - 1;
+			zPT[j][i] = (zP[j1][i] - zP[j0][i]) / (j1 - j0);
+		}
+
+	const double M[4][4] = {{ 1.0,  0.0,  0.0,  0.0},
+	                        { 0.0,  0.0,  1.0,  0.0},
+	                        {-3.0,  3.0, -2.0, -1.0},
+	                        { 2.0, -2.0,  1.0,  1.0}};
+
+	for (int j = 0; j < NT - 1; ++j)
+		for (int i = 0; i < NP - 1; ++i)
+		{
+			// F[a][b]: a - value/derivative at the left/right P node,
+			// b - value/derivative at the lower/upper T node.
+			const double F[4][4] = {
+				{z[j][i],       z[j + 1][i],       zT[j][i],       zT[j + 1][i]},
+				{z[j][i + 1],   z[j + 1][i + 1],   zT[j][i + 1],   zT[j + 1][i + 1]},
+				{zP[j][i],      zP[j + 1][i],      zPT[j][i],      zPT[j + 1][i]},
+				{zP[j][i + 1],  zP[j + 1][i + 1],  zPT[j][i + 1],  zPT[j + 1][i + 1]}};
+
+			double MF[4][4]{};
+			for (int a = 0; a < 4; ++a)
+				for (int b = 0; b < 4; ++b)
+					for (int k = 0; k < 4; ++k)
+						MF[a][b] += M[a][k] * F[k][b];
+
+			for (int a = 0; a < 4; ++a)
+				for (int b = 0; b < 4; ++b)
+				{
+					double s = 0.0;
+					for (int k = 0; k < 4; ++k)
+						s += MF[a][k] * M[b][k];
+					table.c[j * (NP - 1) + i][4 * a + b] = s;
+				}
+		}
+
+	return table;
+}
+
+/*
+	table - Table (makeTable);
+	P     - pressure, atm;
+	T     - temperature, °C.
+	return: z - gas compressibility factor interpolated from the table, points
+	outside the table are extrapolated from the edge cells.
+*/
+template <int NP, int NT>
+inline double eval(const Table<NP, NT> &table, double P, double T)
+{
+	double x = (P - table.PMin) / table.hP;
+	double y = (T - table.TMin) / table.hT;
+	int    i = (int)x - (x < 0.0);
+	int    j = (int)y - (y < 0.0);
+	i = i < 0 ? 0 : (i > NP - 2 ? NP - 2 : i);
+	j = j < 0 ? 0 : (j > NT - 2 ? NT - 2 : j);
+	double u = x - i;
+	double v = y - j;
+
+	const double *c = table.c[j * (NP - 1) + i];
+	double        z = 0.0;
+	for (int k = 3; k >= 0; --k)
+		z = z * u + (((c[4 * k + 3] * v + c[4 * k + 2]) * v + c[4 * k + 1]) * v +
+		             c[4 * k]);
+	return z;
+}
+
+}
+
+#endif